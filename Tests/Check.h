@@ -0,0 +1,20 @@
+#pragma once
+#include <stdio.h>
+
+// each check program links against the engine's sources on the headless backend and
+// returns the number of failed checks, so zero means every check held
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); \
+			++CheckFailures(); \
+		} \
+	} while (false)
@@ -0,0 +1,99 @@
+#include "Check.h"
+#include "../WorldForge/Image.h"
+#include "../WorldForge/BitmapHeaders.h"
+#include <fstream>
+#include <vector>
+
+static Image MakePattern(int width, int height)
+{
+	Image image{ width,height };
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			image.SetPixel(x, y, Color(x * 7, y * 11, (x + y) * 3, (x * y) % 256));
+		}
+	}
+	return image;
+}
+
+static bool isEqual(const Image& a, const Image& b)
+{
+	return a.GetWidth() == b.GetWidth() && a.GetHeight() == b.GetHeight() && a.Export() == b.Export();
+}
+
+// an image loaded from a file must stay intact when saved back over that same file
+static void CheckResaveToSamePath()
+{
+	const char* filename = "DecoderCheck_resave.bmp";
+	const Image original = MakePattern(37, 23);
+	original.Save(filename);
+	const Image loaded{ filename };
+	CHECK(isEqual(loaded, original));
+	loaded.Save(filename);
+	const Image reloaded{ filename };
+	CHECK(isEqual(reloaded, original));
+	CHECK(isEqual(loaded, original));
+	remove(filename);
+}
+
+// bottom-up 24bpp rows are padded to four bytes and stored last row first
+static void CheckBottomUp24()
+{
+	const char* filename = "DecoderCheck_24.bmp";
+	const Image original = MakePattern(5, 3);
+	const int pitch = (original.GetWidth() * 3 + 3) & ~3;
+	BitmapFileHeader fileHead = {};
+	BitmapInfoHeader infoHead = {};
+	fileHead.bfType = 'B' + ('M' << 8);
+	fileHead.bfOffBits = sizeof(fileHead) + sizeof(infoHead);
+	fileHead.bfSize = fileHead.bfOffBits + pitch * original.GetHeight();
+	infoHead.biSize = sizeof(infoHead);
+	infoHead.biWidth = original.GetWidth();
+	infoHead.biHeight = original.GetHeight();
+	infoHead.biPlanes = 1;
+	infoHead.biBitCount = 24;
+	infoHead.biCompression = BitmapCompressionRGB;
+	std::vector<unsigned char> pixelData(pitch * original.GetHeight());
+	for (int y = 0; y < original.GetHeight(); ++y)
+	{
+		unsigned char* const pRow = &pixelData[(original.GetHeight() - y - 1) * pitch];
+		for (int x = 0; x < original.GetWidth(); ++x)
+		{
+			const Color& color = original.GetPixel(x, y);
+			pRow[x * 3] = color.GetB();
+			pRow[x * 3 + 1] = color.GetG();
+			pRow[x * 3 + 2] = color.GetR();
+		}
+	}
+	{
+		std::ofstream bitmapOUT{ filename, std::ios::binary };
+		bitmapOUT.write(reinterpret_cast<const char*>(&fileHead), sizeof(fileHead));
+		bitmapOUT.write(reinterpret_cast<const char*>(&infoHead), sizeof(infoHead));
+		bitmapOUT.write(reinterpret_cast<const char*>(pixelData.data()), pixelData.size());
+	}
+	const Image loaded{ filename };
+	CHECK(loaded.GetWidth() == original.GetWidth() && loaded.GetHeight() == original.GetHeight());
+	int mismatches = 0;
+	for (int y = 0; y < loaded.GetHeight(); ++y)
+	{
+		for (int x = 0; x < loaded.GetWidth(); ++x)
+		{
+			const Color& expected = original.GetPixel(x, y);
+			if (!(loaded.GetPixel(x, y) == Color(expected.GetR(), expected.GetG(), expected.GetB())))
+			{
+				++mismatches;
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+	remove(filename);
+}
+
+int main()
+{
+	CheckResaveToSamePath();
+	CheckBottomUp24();
+	printf("DecoderCheck: %d failed\n", CheckFailures());
+	return CheckFailures();
+}
@@ -0,0 +1,101 @@
+#include "Check.h"
+#include "../WorldForge/Graphics.h"
+#include <algorithm>
+#include <random>
+#include <stdlib.h>
+
+static int CountLit(const Graphics& gfx)
+{
+	const std::vector<Color>& pixels = gfx.GetPixelMap();
+	return (int)std::count_if(pixels.begin(), pixels.end(), [](const Color& c)
+	{
+		return c.GetA() != 0;
+	});
+}
+
+// unclipped, a line lights one pixel per step of its major axis, endpoints included,
+// and every row (or column) it crosses along the minor axis holds one contiguous run
+static void CheckUnclipped(std::mt19937& rng)
+{
+	const int size = 300;
+	Graphics gfx{ size,size,{ { size,size } } };
+	std::uniform_int_distribution<int> coordinate(0, size - 1);
+	for (int trial = 0; trial < 2000; ++trial)
+	{
+		const vec2i p0 = { coordinate(rng),coordinate(rng) };
+		const vec2i p1 = trial % 4 ? vec2i{ coordinate(rng),coordinate(rng) } : vec2i{ p0.x + (int)(rng() % 3),coordinate(rng) };
+		if (p1.x >= size)
+		{
+			continue;
+		}
+		std::fill(gfx.GetPixelMap().begin(), gfx.GetPixelMap().end(), Colors::Transparent);
+		gfx.DrawLine(p0, p1, Colors::White);
+		CHECK(CountLit(gfx) == std::max(abs(p1.x - p0.x), abs(p1.y - p0.y)) + 1);
+		CHECK(gfx.GetPixel(p0.x, p0.y).GetA() != 0);
+		CHECK(gfx.GetPixel(p1.x, p1.y).GetA() != 0);
+	}
+}
+
+// clipping must light exactly the pixels the unclipped line lights inside the layer
+static void CheckClippedMatchesUnclipped(std::mt19937& rng)
+{
+	const int width = 50;
+	const int height = 40;
+	const int offset = 200;
+	Graphics big{ 600,600,{ { 600,600 } } };
+	Graphics small{ width,height,{ { width,height } } };
+	std::uniform_int_distribution<int> coordinate(-150, 200);
+	int mismatches = 0;
+	for (int trial = 0; trial < 20000; ++trial)
+	{
+		const vec2i p0 = { coordinate(rng),coordinate(rng) };
+		const vec2i p1 = trial % 3 ? vec2i{ coordinate(rng),coordinate(rng) } : vec2i{ p0.x + coordinate(rng) % 5,coordinate(rng) };
+		std::fill(big.GetPixelMap().begin(), big.GetPixelMap().end(), Colors::Transparent);
+		std::fill(small.GetPixelMap().begin(), small.GetPixelMap().end(), Colors::Transparent);
+		big.DrawLine({ p0.x + offset,p0.y + offset }, { p1.x + offset,p1.y + offset }, Colors::White);
+		small.DrawLine(p0, p1, Colors::White);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				if ((big.GetPixel(x + offset, y + offset).GetA() != 0) != (small.GetPixel(x, y).GetA() != 0))
+				{
+					++mismatches;
+				}
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+// lines far outside the layer, or crossing it from far away, stay inside it and don't overflow
+static void CheckFarEndpoints()
+{
+	Graphics gfx{ 64,48,{ { 64,48 } } };
+	std::fill(gfx.GetPixelMap().begin(), gfx.GetPixelMap().end(), Colors::Transparent);
+	gfx.DrawLine({ -1000000,-5 }, { 1000000,-5 }, Colors::White);
+	gfx.DrawLine({ 100,100 }, { 2000000,1500000 }, Colors::White);
+	gfx.DrawLine({ -2000000,10 }, { -3,2000000 }, Colors::White);
+	CHECK(CountLit(gfx) == 0);
+	gfx.DrawLine({ -1000000,20 }, { 1000000,20 }, Colors::White);
+	CHECK(CountLit(gfx) == 64);
+	gfx.DrawLine({ 10,-1000000 }, { 10,1000000 }, Colors::White);
+	CHECK(CountLit(gfx) == 64 + 47);
+	std::fill(gfx.GetPixelMap().begin(), gfx.GetPixelMap().end(), Colors::Transparent);
+	gfx.DrawLine({ -2000000,-2000000 }, { 2000000,2000000 }, Colors::White);
+	CHECK(CountLit(gfx) == 48);
+	for (int i = 0; i < 48; ++i)
+	{
+		CHECK(gfx.GetPixel(i, i).GetA() != 0);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	CheckUnclipped(rng);
+	CheckClippedMatchesUnclipped(rng);
+	CheckFarEndpoints();
+	printf("LineClipCheck: %d failed\n", CheckFailures());
+	return CheckFailures();
+}
@@ -0,0 +1,207 @@
+#include "Check.h"
+#include "../WorldForge/Image.h"
+#include "../WorldForge/Graphics.h"
+#include "../WorldForge/WorkerPool.h"
+#include <algorithm>
+#include <random>
+
+struct Operation
+{
+	int kind;
+	int depth;
+	iRect rect;
+	vec2i end;
+	Color color;
+	const Image* pImage;
+};
+
+static const int frameWidth = 320;
+static const int frameHeight = 240;
+
+static bool isVisible(const iRect& rect)
+{
+	return rect.pos.x < frameWidth && rect.pos.x + rect.width > 0 && rect.pos.y < frameHeight && rect.pos.y + rect.height > 0;
+}
+
+static void DrawNow(Graphics& gfx, const Operation& op)
+{
+	const Image& image = *op.pImage;
+	switch (op.kind)
+	{
+	case 0:
+		if (isVisible(image.GetRect(op.rect.pos.x, op.rect.pos.y)))
+		{
+			image.Draw(gfx, op.rect.pos.x, op.rect.pos.y);
+		}
+		break;
+	case 1:
+		if (isVisible(op.rect))
+		{
+			image.Draw(gfx, op.rect.pos.x, op.rect.pos.y, op.rect.width, op.rect.height);
+		}
+		break;
+	case 2:
+		if (isVisible(op.rect))
+		{
+			image.DrawWithTransparency(gfx, op.rect.pos.x, op.rect.pos.y, op.rect.width, op.rect.height);
+		}
+		break;
+	case 3:
+		if (isVisible(image.GetRect(op.rect.pos.x, op.rect.pos.y)))
+		{
+			image.DrawBlended(gfx, op.rect.pos.x, op.rect.pos.y, BlendMode::SourceOver, 0.5f);
+		}
+		break;
+	case 4:
+		if (isVisible(op.rect))
+		{
+			op.rect.Draw(gfx, op.color);
+		}
+		break;
+	case 5:
+		gfx.DrawLine(op.rect.pos, op.end, op.color);
+		break;
+	default:
+		gfx.DrawEllipse(op.rect.pos.x, op.rect.pos.y, op.rect.width, op.rect.height, op.color);
+		break;
+	}
+}
+
+static void Queue(Graphics& gfx, const Operation& op)
+{
+	const Image& image = *op.pImage;
+	switch (op.kind)
+	{
+	case 0:
+		gfx.QueueImage(image, op.rect.pos.x, op.rect.pos.y, op.depth);
+		break;
+	case 1:
+		gfx.QueueImage(image, op.rect, op.depth);
+		break;
+	case 2:
+		gfx.QueueImageWithTransparency(image, op.rect, op.depth);
+		break;
+	case 3:
+		gfx.QueueImageBlended(image, op.rect.pos.x, op.rect.pos.y, BlendMode::SourceOver, 0.5f, op.depth);
+		break;
+	case 4:
+		gfx.QueueRect(op.rect, op.color, op.depth);
+		break;
+	case 5:
+		gfx.QueueLine(op.rect.pos, op.end, op.color, op.depth);
+		break;
+	default:
+		gfx.QueueEllipse(op.rect.pos.x, op.rect.pos.y, op.rect.width, op.rect.height, op.color, op.depth);
+		break;
+	}
+}
+
+// replaying the queue, serially or in bands, must draw what immediate calls made in depth order would
+static void CheckReplayMatchesImmediate(std::mt19937& rng, const std::vector<Image>& images)
+{
+	std::vector<Operation> ops;
+	for (int i = 0; i < 300; ++i)
+	{
+		Operation op;
+		op.kind = rng() % 7;
+		op.depth = rng() % 4;
+		const int x = (int)(rng() % (frameWidth + 60)) - 30;
+		const int y = (int)(rng() % (frameHeight + 60)) - 30;
+		if (op.kind == 1 || op.kind == 2)
+		{
+			// integer zooms as well as arbitrary sizes
+			const int zoom = 1 + rng() % 4;
+			const Image& image = images[rng() % images.size()];
+			op.rect = rng() % 2 ? iRect({ x,y }, image.GetWidth() * zoom, image.GetHeight() * zoom) : iRect({ x,y }, 1 + rng() % 90, 1 + rng() % 70);
+			op.pImage = &image;
+		}
+		else
+		{
+			op.rect = op.kind == 6 ? iRect({ x,y }, 1 + rng() % 50, 1 + rng() % 40) : iRect({ x,y }, 1 + rng() % 80, 1 + rng() % 60);
+			op.pImage = &images[rng() % images.size()];
+		}
+		op.end = { (int)(rng() % (frameWidth + 60)) - 30,(int)(rng() % (frameHeight + 60)) - 30 };
+		op.color = Color((unsigned char)rng(), (unsigned char)rng(), (unsigned char)rng(), (unsigned char)rng());
+		ops.push_back(op);
+	}
+	std::vector<Color> expected;
+	{
+		Graphics gfx{ frameWidth,frameHeight,{ { frameWidth,frameHeight } } };
+		gfx.NewFrame();
+		std::vector<Operation> sorted = ops;
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Operation& a, const Operation& b)
+		{
+			return a.depth < b.depth;
+		});
+		for (const Operation& op : sorted)
+		{
+			DrawNow(gfx, op);
+		}
+		expected = gfx.GetPixelMap();
+		gfx.EndFrame();
+	}
+	for (int parallel = 0; parallel < 2; ++parallel)
+	{
+		WorkerPool::Shared().SetThreadCount(parallel ? 4 : 1);
+		Graphics gfx{ frameWidth,frameHeight,{ { frameWidth,frameHeight } } };
+		if (!parallel)
+		{
+			gfx.DisableParallelReplay();
+		}
+		gfx.NewFrame();
+		for (const Operation& op : ops)
+		{
+			Queue(gfx, op);
+		}
+		gfx.FlushCommands();
+		CHECK(gfx.GetPixelMap() == expected);
+		gfx.EndFrame();
+	}
+}
+
+// queued images keep the pixels they had when queued, even if edited or destroyed before the replay
+static void CheckQueuedImageLifetime()
+{
+	Graphics gfx{ 64,64,{ { 64,64 } } };
+	gfx.NewFrame();
+	gfx.QueueImage(Image{ 4,4,Colors::BrightRed }.Resized(16, 16), 0, 0);
+	Image* pDestroyed = new Image{ 8,8,Colors::BrightGreen };
+	Image edited{ 8,8,Colors::BrightBlue };
+	gfx.QueueImage(*pDestroyed, 20, 20);
+	gfx.QueueImage(edited, 40, 40);
+	edited.InvertColors();
+	delete pDestroyed;
+	gfx.FlushCommands();
+	const std::vector<Color>& pixels = gfx.GetPixelMap();
+	CHECK(pixels[15 * 64 + 15] == Colors::BrightRed);
+	CHECK(pixels[21 * 64 + 21] == Colors::BrightGreen);
+	CHECK(pixels[41 * 64 + 41] == Colors::BrightBlue);
+	CHECK(edited.GetPixel(0, 0) == Colors::BrightBlue.Inverted());
+	gfx.EndFrame();
+}
+
+int main()
+{
+	std::mt19937 rng(5);
+	std::vector<Image> images;
+	for (int i = 0; i < 4; ++i)
+	{
+		Image image{ 17 + i * 9,13 + i * 7 };
+		for (int y = 0; y < image.GetHeight(); ++y)
+		{
+			for (int x = 0; x < image.GetWidth(); ++x)
+			{
+				const unsigned char alpha = (x + y) % 3 ? 255 : ((x * y) % 2 ? 0 : 128);
+				image.SetPixel(x, y, Color((unsigned char)rng(), (unsigned char)rng(), (unsigned char)rng(), alpha));
+			}
+		}
+		images.push_back(image);
+	}
+	for (int trial = 0; trial < 40; ++trial)
+	{
+		CheckReplayMatchesImmediate(rng, images);
+	}
+	CheckQueuedImageLifetime();
+	printf("QueueReplayCheck: %d failed\n", CheckFailures());
+	return CheckFailures();
+}
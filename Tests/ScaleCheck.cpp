@@ -0,0 +1,116 @@
+#include "Check.h"
+#include "../WorldForge/Image.h"
+#include "../WorldForge/Graphics.h"
+
+static Image MakeStripes(const std::vector<Color>& colors)
+{
+	const int n = (int)colors.size();
+	Image image{ n,n };
+	for (int y = 0; y < n; ++y)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			image.SetPixel(x, y, colors[x]);
+		}
+	}
+	return image;
+}
+
+static Image MakeNoise(int width, int height, unsigned int seed)
+{
+	Image image{ width,height };
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			image.SetPixel(x, y, Color((unsigned char)(seed >> 24), (unsigned char)(seed >> 16), (unsigned char)(seed >> 8)));
+		}
+	}
+	return image;
+}
+
+// an integer zoom must give every source pixel the same number of destination pixels, along both axes
+static void CheckIntegerZoom(const std::vector<Color>& colors, int zoom)
+{
+	const Image image = MakeStripes(colors);
+	const int size = image.GetWidth() * zoom;
+	for (int transparency = 0; transparency < 2; ++transparency)
+	{
+		Graphics gfx{ size,size,{ { size,size } } };
+		gfx.NewFrame();
+		if (transparency)
+		{
+			image.DrawWithTransparency(gfx, 0, 0, size, size);
+		}
+		else
+		{
+			image.Draw(gfx, 0, 0, size, size);
+		}
+		const std::vector<Color>& pixels = gfx.GetPixelMap();
+		for (int y = 0; y < size; ++y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				CHECK(pixels[y * size + x] == colors[x / zoom]);
+			}
+		}
+		const Image transposed = image.Transposed();
+		transposed.Draw(gfx, 0, 0, size, size);
+		for (int y = 0; y < size; ++y)
+		{
+			for (int x = 0; x < size; ++x)
+			{
+				CHECK(pixels[y * size + x] == colors[y / zoom]);
+			}
+		}
+		gfx.EndFrame();
+	}
+}
+
+// scaled draws, clipped or not, must pick the same source pixels as a nearest-neighbour resize
+static void CheckAgainstResize(int srcWidth, int srcHeight, int dstWidth, int dstHeight, int x, int y)
+{
+	const Image image = MakeNoise(srcWidth, srcHeight, srcWidth * 131u + dstWidth);
+	const Image resized = image.Resized(dstWidth, dstHeight, ResampleFilter::Nearest);
+	const int frameWidth = 64;
+	const int frameHeight = 48;
+	Graphics gfx{ frameWidth,frameHeight,{ { frameWidth,frameHeight } } };
+	gfx.NewFrame();
+	image.Draw(gfx, x, y, dstWidth, dstHeight);
+	const std::vector<Color>& pixels = gfx.GetPixelMap();
+	int mismatches = 0;
+	for (int dy = 0; dy < dstHeight; ++dy)
+	{
+		for (int dx = 0; dx < dstWidth; ++dx)
+		{
+			const int fx = x + dx;
+			const int fy = y + dy;
+			if (fx >= 0 && fx < frameWidth && fy >= 0 && fy < frameHeight && !(pixels[fy * frameWidth + fx] == resized.GetPixel(dx, dy)))
+			{
+				++mismatches;
+			}
+		}
+	}
+	CHECK(mismatches == 0);
+	gfx.EndFrame();
+}
+
+int main()
+{
+	CheckIntegerZoom({ Colors::BrightRed,Colors::BrightBlue }, 3);
+	CheckIntegerZoom({ Colors::BrightRed,Colors::BrightGreen,Colors::BrightBlue }, 3);
+	CheckIntegerZoom({ Colors::BrightRed,Colors::BrightGreen,Colors::BrightBlue,Colors::White,Colors::Black }, 7);
+	const int sizes[] = { 1,2,3,5,7,16,31,40,63,100 };
+	for (int srcSize : sizes)
+	{
+		for (int dstSize : sizes)
+		{
+			CheckAgainstResize(srcSize, srcSize + 2, dstSize, dstSize + 1, 0, 0);
+			CheckAgainstResize(srcSize, srcSize + 2, dstSize, dstSize + 1, -dstSize / 3, -dstSize / 4);
+			CheckAgainstResize(srcSize, srcSize + 2, dstSize, dstSize + 1, 60 - dstSize / 2, 40 - dstSize / 3);
+		}
+	}
+	printf("ScaleCheck: %d failed\n", CheckFailures());
+	return CheckFailures();
+}
@@ -112,3 +112,13 @@ void Animation::DrawWithTransparency(Graphics& gfx, int x, int y, int layer) con
 {
 	frames[currentFrame].DrawWithTransparency(gfx, x, y, layer);
 }
+
+void Animation::Queue(Graphics& gfx, int x, int y, int depth, int layer) const
+{
+	gfx.QueueImage(frames[currentFrame], x, y, depth, layer);
+}
+
+void Animation::QueueWithTransparency(Graphics& gfx, int x, int y, int depth, int layer) const
+{
+	gfx.QueueImageWithTransparency(frames[currentFrame], x, y, depth, layer);
+}
@@ -28,6 +28,8 @@ public:
 	bool PlayAndCheck(float time_ellapsed);
 	void Draw(Graphics& gfx, int x, int y, int layer = 0) const;
 	void DrawWithTransparency(Graphics& gfx, int x, int y, int layer = 0) const;
+	void Queue(Graphics& gfx, int x, int y, int depth = 0, int layer = 0) const;
+	void QueueWithTransparency(Graphics& gfx, int x, int y, int depth = 0, int layer = 0) const;
 };
 
 
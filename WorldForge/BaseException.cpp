@@ -43,6 +43,7 @@ std::string BaseException::GetNote() const noexcept
 	return note;
 }
 
+#ifdef _WIN32
 std::string BaseException::GetErrorCodeDesc(HRESULT hr) noexcept
 {
 	char* pDescBuffer = nullptr;
@@ -58,7 +59,4 @@ std::string BaseException::GetErrorCodeDesc(HRESULT hr) noexcept
 	LocalFree(pDescBuffer);
 	return desc;
 }
-
-
-
-
+#endif
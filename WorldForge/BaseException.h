@@ -1,5 +1,7 @@
 #pragma once
+#ifdef _WIN32
 #include "Win32Includes.h"
+#endif
 #include <exception>
 #include <string>
 #include <sstream>
@@ -20,8 +22,10 @@ public:
 	int GetLine() const noexcept;
 	std::string GetFile() const noexcept;
 	std::string GetNote() const noexcept;
+#ifdef _WIN32
 public:
 	static std::string GetErrorCodeDesc(HRESULT hr) noexcept;
+#endif
 };
 #define EXCPT BaseException(__LINE__, __FILE__)
 #define EXCPT_NOTE(note) BaseException(__LINE__, __FILE__, note)
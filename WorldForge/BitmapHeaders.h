@@ -0,0 +1,31 @@
+#pragma once
+
+#pragma pack(push, 1)
+struct BitmapFileHeader
+{
+	unsigned short bfType;
+	unsigned int bfSize;
+	unsigned short bfReserved1;
+	unsigned short bfReserved2;
+	unsigned int bfOffBits;
+};
+
+struct BitmapInfoHeader
+{
+	unsigned int biSize;
+	int biWidth;
+	int biHeight;
+	unsigned short biPlanes;
+	unsigned short biBitCount;
+	unsigned int biCompression;
+	unsigned int biSizeImage;
+	int biXPelsPerMeter;
+	int biYPelsPerMeter;
+	unsigned int biClrUsed;
+	unsigned int biClrImportant;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(BitmapFileHeader) == 14 && sizeof(BitmapInfoHeader) == 40);
+
+constexpr unsigned int BitmapCompressionRGB = 0;
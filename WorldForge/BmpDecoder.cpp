@@ -0,0 +1,60 @@
+#include "ImageDecoder.h"
+#include "BitmapHeaders.h"
+#include "PixelKernels.h"
+#include "BaseException.h"
+#include <string.h>
+#include <stdlib.h>
+
+bool BmpDecoder::CanDecode(const unsigned char* pData, size_t size) const
+{
+	return size >= 2 && pData[0] == 'B' && pData[1] == 'M';
+}
+
+DecodedImage BmpDecoder::Decode(const std::shared_ptr<MappedFile>& pFile) const
+{
+	const unsigned char* const pFileData = pFile->GetData();
+	const size_t fileSize = pFile->GetSize();
+	BitmapFileHeader fileHead = {};
+	BitmapInfoHeader infoHead = {};
+	if (fileSize < sizeof(fileHead) + sizeof(infoHead))
+	{
+		throw EXCPT_NOTE("Critical error in reading bitmap file! Please retry.");
+	}
+	memcpy(&fileHead, pFileData, sizeof(fileHead));
+	memcpy(&infoHead, pFileData + sizeof(fileHead), sizeof(infoHead));
+	if (infoHead.biCompression != BitmapCompressionRGB)
+	{
+		throw EXCPT_NOTE("Only uncompressed bitmaps supported! Decompress image and retry.");
+	}
+	if (infoHead.biBitCount != 24 && infoHead.biBitCount != 32)
+	{
+		throw EXCPT_NOTE("Only bitmaps of either 24bpp or 32bpp allowed. Reset color depth of image and retry.");
+	}
+	DecodedImage decoded;
+	decoded.width = infoHead.biWidth;
+	decoded.height = abs(infoHead.biHeight);
+	const int bytesPerPixel = infoHead.biBitCount / 8;
+	const long long filePitch = ((long long)decoded.width * bytesPerPixel + 3) & ~3LL;
+	if (decoded.width <= 0 || decoded.height <= 0 || fileHead.bfOffBits > fileSize || filePitch * decoded.height > (long long)(fileSize - fileHead.bfOffBits))
+	{
+		throw EXCPT_NOTE("Critical error in reading bitmap file! Please retry.");
+	}
+	// pixels are always copied out, so the image never keeps its file mapped or aliases pages that a later save rewrites
+	const unsigned char* const pPixelData = pFileData + fileHead.bfOffBits;
+	decoded.pPixels = AllocatePixels(decoded.width, decoded.height);
+	for (int y = 0; y < decoded.height; ++y)
+	{
+		const int srcY = (infoHead.biHeight > 0) ? decoded.height - y - 1 : y;
+		const unsigned char* const pSrcRow = pPixelData + srcY * filePitch;
+		Color* const pDstRow = &decoded.pPixels[(size_t)y * decoded.width];
+		if (bytesPerPixel == 3)
+		{
+			PixelKernels::ExpandBGRRow(pDstRow, pSrcRow, decoded.width);
+		}
+		else
+		{
+			memcpy(pDstRow, pSrcRow, decoded.width * sizeof(Color));
+		}
+	}
+	return decoded;
+}
@@ -0,0 +1,284 @@
+#include "ChunkedMap.h"
+#include "TileCodec.h"
+#include "BaseException.h"
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+#include <assert.h>
+
+void ChunkedMap::DecodeChunk(int chunk, std::vector<int>& ids) const
+{
+	ChunkEntry entry = {};
+	memcpy(&entry, pFile->GetData() + sizeof(FileHeader) + (size_t)chunk * sizeof(ChunkEntry), sizeof(entry));
+	if (entry.offset > pFile->GetSize() || entry.size > pFile->GetSize() - entry.offset)
+	{
+		throw EXCPT_NOTE("Map chunk lies outside of the file! Please check the file and retry.");
+	}
+	ids.resize((size_t)chunkSize * chunkSize);
+	TileCodec::DecodeRuns(pFile->GetData() + entry.offset, (size_t)entry.size, ids.data(), (int)ids.size(), 0x7FFFFFFF);
+}
+
+ChunkedMap::Chunk& ChunkedMap::Insert(int chunk, std::vector<int> ids)
+{
+	Chunk& c = chunks[chunk];
+	c.ids = std::move(ids);
+	lru.push_front(chunk);
+	c.lruPosition = lru.begin();
+	c.lastUsed = updateStamp;
+	++stats.chunksDecoded;
+	++stats.residentChunks;
+	stats.residentBytes += chunkBytes;
+	return c;
+}
+
+void ChunkedMap::Touch(Chunk& c)
+{
+	lru.splice(lru.begin(), lru, c.lruPosition);
+	c.lastUsed = updateStamp;
+}
+
+void ChunkedMap::CollectDecoded()
+{
+	std::vector<DecodedChunk> ready;
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		ready.swap(decoded);
+	}
+	for (DecodedChunk& d : ready)
+	{
+		pending.erase(d.chunk);
+		// a blocking load may have beaten the background decode to it
+		if (chunks.find(d.chunk) == chunks.end())
+		{
+			Insert(d.chunk, std::move(d.ids));
+		}
+	}
+}
+
+void ChunkedMap::Request(int chunk)
+{
+	const auto it = chunks.find(chunk);
+	if (it != chunks.end())
+	{
+		Touch(it->second);
+		return;
+	}
+	if (pending.find(chunk) != pending.end())
+	{
+		return;
+	}
+	pending[chunk] = decoder.Submit([this, chunk]()
+	{
+		DecodedChunk d = { chunk,{} };
+		DecodeChunk(chunk, d.ids);
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back(std::move(d));
+	});
+}
+
+void ChunkedMap::Evict()
+{
+	// chunks requested by the latest update are kept even if that overshoots the budget
+	while (stats.residentBytes > memoryBudget && !lru.empty())
+	{
+		const int chunk = lru.back();
+		const auto it = chunks.find(chunk);
+		if (it->second.lastUsed == updateStamp)
+		{
+			break;
+		}
+		if (chunk == lastChunk)
+		{
+			lastChunk = -1;
+			pLastChunk = nullptr;
+		}
+		chunks.erase(it);
+		lru.pop_back();
+		++stats.chunksEvicted;
+		--stats.residentChunks;
+		stats.residentBytes -= chunkBytes;
+	}
+}
+
+ChunkedMap::ChunkedMap(const char* filename, size_t memory_budget, int prefetch_radius)
+	:
+	pFile(std::make_shared<MappedFile>(filename)),
+	memoryBudget(memory_budget),
+	prefetchRadius(prefetch_radius)
+{
+	assert(prefetch_radius >= 0);
+	FileHeader header = {};
+	if (pFile->GetSize() < sizeof(header))
+	{
+		throw EXCPT_NOTE("File is too small to be a chunked map! Please check the file and retry.");
+	}
+	memcpy(&header, pFile->GetData(), sizeof(header));
+	if (memcmp(header.magic, "WFCM", 4) != 0 || header.version != fileVersion)
+	{
+		throw EXCPT_NOTE("File is not a supported chunked map! Please check the file and retry.");
+	}
+	if (header.width <= 0 || header.height <= 0 || header.chunkSize <= 0 || header.chunkSize > 4096)
+	{
+		throw EXCPT_NOTE("Chunked map has invalid dimensions! Please check the file and retry.");
+	}
+	mapDim = { header.width,header.height };
+	chunkSize = header.chunkSize;
+	chunkGrid = { (mapDim.x + chunkSize - 1) / chunkSize,(mapDim.y + chunkSize - 1) / chunkSize };
+	chunkBytes = (size_t)chunkSize * chunkSize * sizeof(int);
+	if ((long long)chunkGrid.x * chunkGrid.y > 0x7FFFFFFF ||
+		(pFile->GetSize() - sizeof(header)) / sizeof(ChunkEntry) < (size_t)chunkGrid.x * chunkGrid.y)
+	{
+		throw EXCPT_NOTE("Chunked map index is truncated! Please check the file and retry.");
+	}
+}
+
+void ChunkedMap::Write(const char* filename, int2 map_dims, const std::function<int(int, int)>& tile_at, int chunk_size)
+{
+	assert(map_dims.x > 0 && map_dims.y > 0);
+	assert(chunk_size > 0 && chunk_size <= 4096);
+	std::ofstream mapOUT{ filename, std::ios::binary };
+	if (!mapOUT)
+	{
+		throw EXCPT_NOTE("Map file could not be created! Check directory and/or file name spelling and retry.");
+	}
+	FileHeader header = { { 'W','F','C','M' },fileVersion,map_dims.x,map_dims.y,chunk_size };
+	const int gridX = (map_dims.x + chunk_size - 1) / chunk_size;
+	const int gridY = (map_dims.y + chunk_size - 1) / chunk_size;
+	std::vector<ChunkEntry> entries((size_t)gridX * gridY);
+	mapOUT.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	mapOUT.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+	unsigned long long offset = sizeof(header) + entries.size() * sizeof(ChunkEntry);
+	std::vector<int> ids((size_t)chunk_size * chunk_size);
+	std::vector<unsigned char> payload;
+	for (int cy = 0; cy < gridY; ++cy)
+	{
+		for (int cx = 0; cx < gridX; ++cx)
+		{
+			// tiles past the map's edge are padded with id 0
+			for (int y = 0; y < chunk_size; ++y)
+			{
+				for (int x = 0; x < chunk_size; ++x)
+				{
+					const int mx = cx * chunk_size + x;
+					const int my = cy * chunk_size + y;
+					ids[(size_t)y * chunk_size + x] = (mx < map_dims.x && my < map_dims.y) ? tile_at(mx, my) : 0;
+				}
+			}
+			payload.clear();
+			TileCodec::EncodeRuns(ids.data(), (int)ids.size(), payload);
+			entries[(size_t)cy * gridX + cx] = { offset,payload.size() };
+			mapOUT.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+			offset += payload.size();
+		}
+	}
+	mapOUT.seekp(sizeof(header));
+	mapOUT.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+	if (!mapOUT)
+	{
+		throw EXCPT_NOTE("Map file could not be written! Please retry.");
+	}
+}
+
+const int2& ChunkedMap::GetDimensions() const
+{
+	return mapDim;
+}
+
+const int& ChunkedMap::GetChunkSize() const
+{
+	return chunkSize;
+}
+
+void ChunkedMap::SetMemoryBudget(size_t bytes)
+{
+	memoryBudget = bytes;
+	Evict();
+}
+
+void ChunkedMap::SetPrefetchRadius(int radius)
+{
+	assert(radius >= 0);
+	prefetchRadius = radius;
+}
+
+void ChunkedMap::Update(const iRect& visible_tiles)
+{
+	CollectDecoded();
+	++updateStamp;
+	const int left = std::clamp(visible_tiles.pos.x / chunkSize, 0, chunkGrid.x - 1);
+	const int top = std::clamp(visible_tiles.pos.y / chunkSize, 0, chunkGrid.y - 1);
+	const int right = std::clamp((visible_tiles.pos.x + visible_tiles.width - 1) / chunkSize, 0, chunkGrid.x - 1);
+	const int bottom = std::clamp((visible_tiles.pos.y + visible_tiles.height - 1) / chunkSize, 0, chunkGrid.y - 1);
+	// visible chunks are queued ahead of the prefetch ring around them
+	for (int cy = top; cy <= bottom; ++cy)
+	{
+		for (int cx = left; cx <= right; ++cx)
+		{
+			Request(cy * chunkGrid.x + cx);
+		}
+	}
+	for (int cy = std::max(top - prefetchRadius, 0); cy <= std::min(bottom + prefetchRadius, chunkGrid.y - 1); ++cy)
+	{
+		for (int cx = std::max(left - prefetchRadius, 0); cx <= std::min(right + prefetchRadius, chunkGrid.x - 1); ++cx)
+		{
+			if (cx < left || cx > right || cy < top || cy > bottom)
+			{
+				Request(cy * chunkGrid.x + cx);
+			}
+		}
+	}
+	Evict();
+}
+
+void ChunkedMap::FinishLoading()
+{
+	decoder.WaitIdle();
+	CollectDecoded();
+}
+
+bool ChunkedMap::isResident(int x, int y) const
+{
+	assert(x >= 0 && x < mapDim.x && y >= 0 && y < mapDim.y);
+	return chunks.find((y / chunkSize) * chunkGrid.x + x / chunkSize) != chunks.end();
+}
+
+int ChunkedMap::GetTile(int x, int y)
+{
+	assert(x >= 0 && x < mapDim.x && y >= 0 && y < mapDim.y);
+	const int chunk = (y / chunkSize) * chunkGrid.x + x / chunkSize;
+	if (chunk != lastChunk)
+	{
+		auto it = chunks.find(chunk);
+		if (it == chunks.end())
+		{
+			const auto fence = pending.find(chunk);
+			if (fence != pending.end())
+			{
+				// needed before the background decode got to it
+				++stats.blockingLoads;
+				decoder.Wait(fence->second);
+				CollectDecoded();
+				it = chunks.find(chunk);
+			}
+		}
+		if (it == chunks.end())
+		{
+			// nothing had requested this chunk, so decode it on the spot
+			std::vector<int> ids;
+			DecodeChunk(chunk, ids);
+			++stats.blockingLoads;
+			pLastChunk = &Insert(chunk, std::move(ids));
+		}
+		else
+		{
+			pLastChunk = &it->second;
+		}
+		lastChunk = chunk;
+	}
+	return pLastChunk->ids[(size_t)(y % chunkSize) * chunkSize + x % chunkSize];
+}
+
+const ChunkedMap::Stats& ChunkedMap::GetStats() const
+{
+	return stats;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "MappedFile.h"
+#include "SubmissionThread.h"
+#include "Rect.h"
+#include <memory>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+
+// tile maps too large to hold in memory, split into square chunks of run-length encoded ids;
+// chunks around the visible area are decoded in the background and evicted least recently used first
+class ChunkedMap
+{
+public:
+	struct Stats
+	{
+		int residentChunks = 0;
+		size_t residentBytes = 0;
+		long long chunksDecoded = 0;
+		long long chunksEvicted = 0;
+		long long blockingLoads = 0;
+	};
+private:
+	struct FileHeader
+	{
+		char magic[4];
+		unsigned int version;
+		int width;
+		int height;
+		int chunkSize;
+	};
+	struct ChunkEntry
+	{
+		unsigned long long offset;
+		unsigned long long size;
+	};
+	struct Chunk
+	{
+		std::vector<int> ids;
+		std::list<int>::iterator lruPosition;
+		unsigned long long lastUsed;
+	};
+	struct DecodedChunk
+	{
+		int chunk;
+		std::vector<int> ids;
+	};
+	static constexpr unsigned int fileVersion = 1;
+private:
+	std::shared_ptr<MappedFile> pFile;
+	int2 mapDim;
+	int chunkSize;
+	int2 chunkGrid;
+	size_t chunkBytes;
+	size_t memoryBudget;
+	int prefetchRadius;
+	std::unordered_map<int, Chunk> chunks;
+	std::list<int> lru;
+	std::unordered_map<int, unsigned long long> pending;
+	std::mutex decodedMutex;
+	std::vector<DecodedChunk> decoded;
+	unsigned long long updateStamp = 0;
+	int lastChunk = -1;
+	const Chunk* pLastChunk = nullptr;
+	Stats stats;
+	// declared last so that it finishes its jobs before anything they touch is destroyed
+	SubmissionThread decoder;
+private:
+	void DecodeChunk(int chunk, std::vector<int>& ids) const;
+	Chunk& Insert(int chunk, std::vector<int> ids);
+	void Touch(Chunk& c);
+	void CollectDecoded();
+	void Request(int chunk);
+	void Evict();
+public:
+	ChunkedMap() = delete;
+	ChunkedMap(const ChunkedMap& map) = delete;
+	ChunkedMap& operator =(const ChunkedMap& map) = delete;
+	ChunkedMap(const char* filename, size_t memory_budget = 64 << 20, int prefetch_radius = 1);
+	static void Write(const char* filename, int2 map_dims, const std::function<int(int, int)>& tile_at, int chunk_size = 64);
+	const int2& GetDimensions() const;
+	const int& GetChunkSize() const;
+	void SetMemoryBudget(size_t bytes);
+	void SetPrefetchRadius(int radius);
+	void Update(const iRect& visible_tiles);
+	void FinishLoading();
+	bool isResident(int x, int y) const;
+	int GetTile(int x, int y);
+	const Stats& GetStats() const;
+};
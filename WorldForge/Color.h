@@ -94,19 +94,19 @@ public:
 	}
 	void SetRn(float _r)
 	{
-		r = unsigned char(_r * 255.0f);
+		r = (unsigned char)(_r * 255.0f);
 	}
 	void SetGn(float _g)
 	{
-		g = unsigned char(_g * 255.0f);
+		g = (unsigned char)(_g * 255.0f);
 	}
 	void SetBn(float _b)
 	{
-		b = unsigned char(_b * 255.0f);
+		b = (unsigned char)(_b * 255.0f);
 	}
 	void SetAn(float _a)
 	{
-		a = unsigned char(_a * 255.0f);
+		a = (unsigned char)(_a * 255.0f);
 	}
 	vec4 GetVector() const
 	{
@@ -182,6 +182,23 @@ public:
 	}
 };
 
+enum class BlendMode
+{
+	SourceOver,
+	PremultipliedSourceOver,
+	Additive,
+	Multiply,
+	Screen
+};
+
+enum class ResampleFilter
+{
+	Nearest,
+	Bilinear,
+	Box,
+	Lanczos3
+};
+
 namespace Colors
 {
 	constexpr Color Black = Color(0, 0, 0);
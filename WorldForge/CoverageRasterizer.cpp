@@ -0,0 +1,210 @@
+#include "CoverageRasterizer.h"
+#include "PixelKernels.h"
+#include "Rect.h"
+#include <math.h>
+#include <algorithm>
+
+static void AccumulateLine(float* pAccumulation, int stride, vec2 p0, vec2 p1)
+{
+	if (p0.y == p1.y)
+	{
+		return;
+	}
+	float dir = 1.0f;
+	if (p0.y > p1.y)
+	{
+		std::swap(p0, p1);
+		dir = -1.0f;
+	}
+	const float xMax = (float)(stride - 2);
+	const float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+	const int yEnd = (int)ceilf(p1.y);
+	float x = p0.x;
+	for (int y = (int)p0.y; y < yEnd; ++y)
+	{
+		float* const pRow = pAccumulation + (size_t)y * stride;
+		const float dy = std::min((float)(y + 1), p1.y) - std::max((float)y, p0.y);
+		const float xNext = x + dxdy * dy;
+		const float d = dy * dir;
+		const float x0 = std::clamp(std::min(x, xNext), 0.0f, xMax);
+		const float x1 = std::clamp(std::max(x, xNext), 0.0f, xMax);
+		const float x0Floor = floorf(x0);
+		const int x0i = (int)x0Floor;
+		const int x1i = (int)ceilf(x1);
+		if (x1i <= x0i + 1)
+		{
+			const float xMid = 0.5f * (x0 + x1) - x0Floor;
+			pRow[x0i] += d - d * xMid;
+			pRow[x0i + 1] += d * xMid;
+		}
+		else
+		{
+			const float s = 1.0f / (x1 - x0);
+			const float x0f = x0 - x0Floor;
+			const float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+			const float x1f = x1 - (float)x1i + 1.0f;
+			const float am = 0.5f * s * x1f * x1f;
+			pRow[x0i] += d * a0;
+			if (x1i == x0i + 2)
+			{
+				pRow[x0i + 1] += d * (1.0f - a0 - am);
+			}
+			else
+			{
+				const float a1 = s * (1.5f - x0f);
+				pRow[x0i + 1] += d * (a1 - a0);
+				for (int xi = x0i + 2; xi < x1i - 1; ++xi)
+				{
+					pRow[xi] += d * s;
+				}
+				const float a2 = a1 + (float)(x1i - x0i - 3) * s;
+				pRow[x1i - 1] += d * (1.0f - a2 - am);
+			}
+			pRow[x1i] += d * am;
+		}
+		x = xNext;
+	}
+}
+
+static void AccumulateEdge(float* pAccumulation, int stride, int height, vec2 p0, vec2 p1)
+{
+	const float h = (float)height;
+	if (p0.y == p1.y || (p0.y <= 0.0f && p1.y <= 0.0f) || (p0.y >= h && p1.y >= h))
+	{
+		return;
+	}
+	const float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+	const auto clampY = [&](vec2& p)
+	{
+		const float y = std::clamp(p.y, 0.0f, h);
+		p.x += (y - p.y) * dxdy;
+		p.y = y;
+	};
+	clampY(p0);
+	clampY(p1);
+	// coverage left of the region still winds the pixels inside it, so split at the side
+	// boundaries and fold the outside pieces onto them as vertical edges
+	const float w = (float)(stride - 2);
+	const float dx = p1.x - p0.x;
+	float t[4] = { 0.0f };
+	int nSplits = 1;
+	if (dx != 0.0f)
+	{
+		for (const float bound : { 0.0f, w })
+		{
+			const float tBound = (bound - p0.x) / dx;
+			if (tBound > 0.0f && tBound < 1.0f)
+			{
+				t[nSplits++] = tBound;
+			}
+		}
+		if (nSplits == 3 && t[2] < t[1])
+		{
+			std::swap(t[1], t[2]);
+		}
+	}
+	t[nSplits] = 1.0f;
+	vec2 a = { std::clamp(p0.x, 0.0f, w), p0.y };
+	for (int i = 1; i <= nSplits; ++i)
+	{
+		const vec2 b = (i == nSplits) ?
+			vec2{ std::clamp(p1.x, 0.0f, w), p1.y } :
+			vec2{ std::clamp(p0.x + dx * t[i], 0.0f, w), p0.y + (p1.y - p0.y) * t[i] };
+		AccumulateLine(pAccumulation, stride, a, b);
+		a = b;
+	}
+}
+
+void CoverageRasterizer::AppendStrokeEdges(std::vector<Edge>& edges, vec2 p0, vec2 p1, float thickness)
+{
+	const float dx = p1.x - p0.x;
+	const float dy = p1.y - p0.y;
+	const float length = sqrtf(dx * dx + dy * dy);
+	if (length == 0.0f || thickness <= 0.0f)
+	{
+		return;
+	}
+	const float halfThickness = thickness * 0.5f;
+	const vec2 along = { dx / length * halfThickness, dy / length * halfThickness };
+	const vec2 normal = { -along.y, along.x };
+	const vec2 start = p0 - along;
+	const vec2 end = p1 + along;
+	const vec2 corners[4] = { start + normal, end + normal, end - normal, start - normal };
+	for (int i = 0; i < 4; ++i)
+	{
+		edges.push_back({ corners[i], corners[(i + 1) % 4] });
+	}
+}
+
+void CoverageRasterizer::Fill(Graphics& gfx, const std::vector<Edge>& edges, const Color& color, int layer)
+{
+	if (edges.empty() || color.GetA() == 0)
+	{
+		return;
+	}
+	float minX = edges[0].p0.x;
+	float minY = edges[0].p0.y;
+	float maxX = minX;
+	float maxY = minY;
+	for (const Edge& e : edges)
+	{
+		minX = std::min({ minX, e.p0.x, e.p1.x });
+		minY = std::min({ minY, e.p0.y, e.p1.y });
+		maxX = std::max({ maxX, e.p0.x, e.p1.x });
+		maxY = std::max({ maxY, e.p0.y, e.p1.y });
+	}
+	const int layerWidth = gfx.GetWidth(layer);
+	const int layerHeight = gfx.GetHeight(layer);
+	const int left = (int)floorf(std::clamp(minX, 0.0f, (float)layerWidth));
+	const int top = (int)floorf(std::clamp(minY, 0.0f, (float)layerHeight));
+	const int right = (int)ceilf(std::clamp(maxX, 0.0f, (float)layerWidth));
+	const int bottom = (int)ceilf(std::clamp(maxY, 0.0f, (float)layerHeight));
+	if (left >= right || top >= bottom)
+	{
+		return;
+	}
+	const int width = right - left;
+	const int height = bottom - top;
+	const int stride = width + 2;
+	// every resolved cell is zeroed again, so the buffer only ever needs to grow
+	thread_local std::vector<float> accumulation;
+	thread_local std::vector<Color> coverageRow;
+	if (accumulation.size() < (size_t)stride * height)
+	{
+		accumulation.resize((size_t)stride * height, 0.0f);
+	}
+	coverageRow.resize(width);
+	const vec2 origin = { (float)left, (float)top };
+	for (const Edge& e : edges)
+	{
+		AccumulateEdge(accumulation.data(), stride, height, e.p0 - origin, e.p1 - origin);
+	}
+	std::vector<Color>& pixels = gfx.GetPixelMap(layer);
+	for (int y = 0; y < height; ++y)
+	{
+		float* const pRow = &accumulation[(size_t)y * stride];
+		float sum = 0.0f;
+		int first = width;
+		int last = -1;
+		for (int x = 0; x < width; ++x)
+		{
+			sum += pRow[x];
+			pRow[x] = 0.0f;
+			const int coverage = (int)(std::min(1.0f, fabsf(sum)) * 255.0f + 0.5f);
+			const int alpha = (coverage * color.GetA() + 127) / 255;
+			coverageRow[x] = Color(color.GetR(), color.GetG(), color.GetB(), (unsigned char)alpha);
+			if (alpha != 0)
+			{
+				first = std::min(first, x);
+				last = x;
+			}
+		}
+		pRow[width] = 0.0f;
+		pRow[width + 1] = 0.0f;
+		if (first <= last)
+		{
+			PixelKernels::BlendRow(&pixels[(size_t)(top + y) * layerWidth + left + first], &coverageRow[first], last - first + 1, BlendMode::SourceOver);
+		}
+	}
+	gfx.MarkDirty(iRect({ left, top }, width, height), layer);
+}
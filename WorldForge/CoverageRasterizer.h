@@ -0,0 +1,14 @@
+#pragma once
+#include "Graphics.h"
+#include <vector>
+
+namespace CoverageRasterizer
+{
+	struct Edge
+	{
+		vec2 p0;
+		vec2 p1;
+	};
+	void AppendStrokeEdges(std::vector<Edge>& edges, vec2 p0, vec2 p1, float thickness);
+	void Fill(Graphics& gfx, const std::vector<Edge>& edges, const Color& color, int layer = 0);
+}
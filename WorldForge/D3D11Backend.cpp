@@ -0,0 +1,365 @@
+#include "D3D11Backend.h"
+#ifdef _WIN32
+#include "Graphics.h"
+#include <string.h>
+#include <assert.h>
+#pragma comment(lib, "d3d11.lib")
+
+using namespace Microsoft::WRL;
+
+D3D11Backend::LayerResources& D3D11Backend::GetLayer(int layer)
+{
+	if (layer >= (int)Layers.size())
+	{
+		Layers.resize(layer + 1);
+	}
+	return Layers[layer];
+}
+
+D3D11Backend::D3D11Backend(HWND hWnd, int WindowWidth, int WindowHeight)
+{
+	DXGI_SWAP_CHAIN_DESC scd = {};
+	scd.BufferCount = 2;
+	scd.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	scd.BufferDesc.Width = WindowWidth;
+	scd.BufferDesc.Height = WindowHeight;
+	scd.BufferDesc.RefreshRate.Numerator = 0;
+	scd.BufferDesc.RefreshRate.Denominator = 1;
+	scd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
+	scd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+	scd.Flags = 0;
+	scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	scd.OutputWindow = hWnd;
+	scd.SampleDesc.Count = 1;
+	scd.SampleDesc.Quality = 0;
+	scd.Windowed = TRUE;
+	scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+
+	UINT dxFlags = 0;
+
+#ifdef _DEBUG
+	dxFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	GFXCHECK(D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, dxFlags, nullptr, 0, D3D11_SDK_VERSION, &scd, &pFrameManager, &pDevice, nullptr, &pPipeline));
+
+	ComPtr<ID3D11Resource> pBackBuffer = nullptr;
+	GFXCHECK(pFrameManager->GetBuffer(0, __uuidof(ID3D11Resource), &pBackBuffer));
+	GFXCHECK(pDevice->CreateRenderTargetView(pBackBuffer.Get(), nullptr, &pFrameBufferView));
+
+	pPipeline->OMSetRenderTargets(1, pFrameBufferView.GetAddressOf(), nullptr);
+
+	ComPtr<ID3D11Buffer> pBuffer;
+	D3D11_BUFFER_DESC bd = {};
+	D3D11_SUBRESOURCE_DATA sd = {};
+
+	bd = {};
+	bd.ByteWidth = UINT(std::size(quad) * sizeof(Vertex));
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+	bd.StructureByteStride = sizeof(Vertex);
+	sd = {};
+	sd.pSysMem = quad;
+	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &pQuadVertices));
+	UINT offset = 0;
+	pPipeline->IASetVertexBuffers(0, 1, pQuadVertices.GetAddressOf(), &bd.StructureByteStride, &offset);
+	// wrapped layers shift their texture coordinates, which is rewritten per draw
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &pWrappedQuadVertices));
+
+	unsigned short IBuffer[6] = { 2,0,1, 1,3,2 };
+	bd = {};
+	bd.ByteWidth = UINT(std::size(IBuffer) * sizeof(unsigned short));
+	bd.Usage = D3D11_USAGE_DEFAULT;
+	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+	bd.StructureByteStride = sizeof(unsigned short);
+	sd = {};
+	sd.pSysMem = IBuffer;
+	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &pBuffer));
+	pPipeline->IASetIndexBuffer(pBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+
+	ComPtr<ID3D11InputLayout> pILayout = nullptr;
+	D3D11_INPUT_ELEMENT_DESC ied[2];
+	ied[0].AlignedByteOffset = 0;
+	ied[0].Format = DXGI_FORMAT_R32G32_FLOAT;
+	ied[0].InputSlot = 0;
+	ied[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	ied[0].InstanceDataStepRate = 0;
+	ied[0].SemanticIndex = 0;
+	ied[0].SemanticName = "Position";
+	ied[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	ied[1].Format = DXGI_FORMAT_R32G32_FLOAT;
+	ied[1].InputSlot = 0;
+	ied[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	ied[1].InstanceDataStepRate = 0;
+	ied[1].SemanticIndex = 0;
+	ied[1].SemanticName = "TextureCoordinate";
+	GFXCHECK(pDevice->CreateInputLayout(ied, (UINT)std::size(ied), VSS::Default.GetByteCode(), VSS::Default.GetByteCodeSize(), &pILayout));
+	pPipeline->IASetInputLayout(pILayout.Get());
+
+	ComPtr<ID3D11BlendState> pColorBlender = nullptr;
+	D3D11_BLEND_DESC bld = {};
+	bld.AlphaToCoverageEnable = FALSE;
+	bld.IndependentBlendEnable = FALSE;
+	bld.RenderTarget[0].BlendEnable = TRUE;
+	bld.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+	bld.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	bld.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	bld.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_DEST_ALPHA;
+	bld.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+	bld.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	bld.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	GFXCHECK(pDevice->CreateBlendState(&bld, &pColorBlender));
+	pPipeline->OMSetBlendState(pColorBlender.Get(), nullptr, 0xFFFFFFFF);
+
+	pPipeline->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D11Backend::CreateLayer(int layer, const LayerDesc& desc)
+{
+	LayerResources& L = GetLayer(layer);
+	const bool isNew = !L.pPixelMap;
+	L.width = desc.width;
+	L.height = desc.height;
+	L.partialUploads = desc.partialUploads;
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	td.ArraySize = 1;
+	td.MipLevels = 1;
+	td.Usage = desc.partialUploads ? D3D11_USAGE_DEFAULT : D3D11_USAGE_DYNAMIC;
+	td.SampleDesc.Count = 1;
+	td.SampleDesc.Quality = 0;
+	td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	td.CPUAccessFlags = desc.partialUploads ? 0 : D3D11_CPU_ACCESS_WRITE;
+	td.Width = desc.width;
+	td.Height = desc.height;
+	D3D11_SUBRESOURCE_DATA sd = {};
+	sd.pSysMem = desc.pPixels;
+	sd.SysMemPitch = desc.width * sizeof(Color);
+	L.pPixelMapView = nullptr;
+	L.pPixelMap = nullptr;
+	GFXCHECK(pDevice->CreateTexture2D(&td, &sd, &L.pPixelMap));
+	D3D11_SHADER_RESOURCE_VIEW_DESC vd = {};
+	vd.Format = td.Format;
+	vd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	vd.Texture2D.MipLevels = 1;
+	vd.Texture2D.MostDetailedMip = 0;
+	GFXCHECK(pDevice->CreateShaderResourceView(L.pPixelMap.Get(), &vd, &L.pPixelMapView));
+	if (isNew)
+	{
+		GFXCHECK(pDevice->CreatePixelShader(PSS::Default.GetByteCode(), PSS::Default.GetByteCodeSize(), nullptr, &L.pPShader));
+		GFXCHECK(pDevice->CreateVertexShader(VSS::Default.GetByteCode(), VSS::Default.GetByteCodeSize(), nullptr, &L.pVShader));
+		SetLayerFiltering(layer, false);
+	}
+}
+
+void D3D11Backend::UploadLayer(int layer, const Color* pPixels, int pitch)
+{
+	LayerResources& L = Layers[layer];
+	if (L.partialUploads)
+	{
+		pPipeline->UpdateSubresource(L.pPixelMap.Get(), 0, nullptr, pPixels, pitch, 0);
+		return;
+	}
+#ifdef _DEBUG
+	GFXCHECK(pPipeline->Map(L.pPixelMap.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
+#else
+	pPipeline->Map(L.pPixelMap.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr);
+#endif
+	if ((int)msr.RowPitch == pitch)
+	{
+		memcpy(msr.pData, pPixels, (size_t)pitch * L.height);
+	}
+	else
+	{
+		const int rowBytes = L.width * sizeof(Color);
+		for (int y = 0; y < L.height; ++y)
+		{
+			memcpy((char*)msr.pData + (size_t)y * msr.RowPitch, (const char*)pPixels + (size_t)y * pitch, rowBytes);
+		}
+	}
+	pPipeline->Unmap(L.pPixelMap.Get(), 0);
+}
+
+void D3D11Backend::UploadLayerRegion(int layer, const Color* pPixels, int pitch, const DirtyRect& region)
+{
+	LayerResources& L = Layers[layer];
+	assert(L.partialUploads);
+	D3D11_BOX box = {};
+	box.left = (UINT)region.left;
+	box.top = (UINT)region.top;
+	box.front = 0;
+	box.right = (UINT)region.right;
+	box.bottom = (UINT)region.bottom;
+	box.back = 1;
+	const Color* const pSrc = (const Color*)((const char*)pPixels + (size_t)region.top * pitch) + region.left;
+	pPipeline->UpdateSubresource(L.pPixelMap.Get(), 0, &box, pSrc, pitch, 0);
+}
+
+void D3D11Backend::SetLayerFiltering(int layer, bool bilinear)
+{
+	D3D11_SAMPLER_DESC smd = {};
+	smd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	smd.AddressV = smd.AddressU;
+	smd.AddressW = smd.AddressV;
+	smd.Filter = bilinear ? D3D11_FILTER_MIN_MAG_MIP_LINEAR : D3D11_FILTER_MIN_MAG_MIP_POINT;
+	GFXCHECK(pDevice->CreateSamplerState(&smd, &Layers[layer].pSampler));
+	smd.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	smd.AddressV = smd.AddressU;
+	smd.AddressW = smd.AddressV;
+	GFXCHECK(pDevice->CreateSamplerState(&smd, &Layers[layer].pWrapSampler));
+}
+
+void D3D11Backend::SetPixelShader(const Shader& shader, int layer)
+{
+	GFXCHECK(pDevice->CreatePixelShader(shader.GetByteCode(), shader.GetByteCodeSize(), nullptr, &Layers[layer].pPShader));
+}
+
+void D3D11Backend::SetVertexShader(const Shader& shader, int layer)
+{
+	GFXCHECK(pDevice->CreateVertexShader(shader.GetByteCode(), shader.GetByteCodeSize(), nullptr, &Layers[layer].pVShader));
+}
+
+void D3D11Backend::CreateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer)
+{
+	D3D11_BUFFER_DESC bd = {};
+	bd.ByteWidth = size;
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.MiscFlags = 0;
+	bd.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA sd = {};
+	sd.pSysMem = pData;
+	LayerResources& L = Layers[layer];
+	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, stage == ShaderStage::Pixel ? &L.pPSCBUF : &L.pVSCBUF));
+}
+
+void D3D11Backend::UpdateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer)
+{
+	LayerResources& L = Layers[layer];
+	ID3D11Buffer* const pBuffer = stage == ShaderStage::Pixel ? L.pPSCBUF.Get() : L.pVSCBUF.Get();
+	GFXCHECK(pPipeline->Map(pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
+	memcpy(msr.pData, pData, size);
+	pPipeline->Unmap(pBuffer, 0);
+}
+
+void D3D11Backend::BeginFrame(const float4& background)
+{
+	pPipeline->ClearRenderTargetView(pFrameBufferView.Get(), &background.x);
+}
+
+void D3D11Backend::DrawLayer(int layer, const LayerTransform& transform)
+{
+	const LayerResources& L = Layers[layer];
+	D3D11_VIEWPORT vp = {};
+	vp.TopLeftX = transform.viewport.TopLeftX;
+	vp.TopLeftY = transform.viewport.TopLeftY;
+	vp.Width = transform.viewport.Width;
+	vp.Height = transform.viewport.Height;
+	vp.MaxDepth = 1.0f;
+	vp.MinDepth = 0.0f;
+	pPipeline->PSSetShader(L.pPShader.Get(), nullptr, 0);
+	pPipeline->PSSetConstantBuffers(0, 1, L.pPSCBUF.GetAddressOf());
+	pPipeline->VSSetShader(L.pVShader.Get(), nullptr, 0);
+	pPipeline->VSSetConstantBuffers(0, 1, L.pVSCBUF.GetAddressOf());
+	pPipeline->PSSetShaderResources(0, 1, L.pPixelMapView.GetAddressOf());
+	pPipeline->RSSetViewports(1, &vp);
+	if (transform.wrapOrigin.x == 0 && transform.wrapOrigin.y == 0)
+	{
+		pPipeline->PSSetSamplers(0, 1, L.pSampler.GetAddressOf());
+		pPipeline->DrawIndexed(6, 0, 0);
+		return;
+	}
+	const float du = (float)transform.wrapOrigin.x / (float)L.width;
+	const float dv = (float)transform.wrapOrigin.y / (float)L.height;
+	GFXCHECK(pPipeline->Map(pWrappedQuadVertices.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
+	Vertex* const pVertices = static_cast<Vertex*>(msr.pData);
+	for (int i = 0; i < (int)std::size(quad); ++i)
+	{
+		pVertices[i] = quad[i];
+		pVertices[i].tc.u += du;
+		pVertices[i].tc.v += dv;
+	}
+	pPipeline->Unmap(pWrappedQuadVertices.Get(), 0);
+	const UINT stride = sizeof(Vertex);
+	const UINT offset = 0;
+	pPipeline->IASetVertexBuffers(0, 1, pWrappedQuadVertices.GetAddressOf(), &stride, &offset);
+	pPipeline->PSSetSamplers(0, 1, L.pWrapSampler.GetAddressOf());
+	pPipeline->DrawIndexed(6, 0, 0);
+	pPipeline->IASetVertexBuffers(0, 1, pQuadVertices.GetAddressOf(), &stride, &offset);
+}
+
+void D3D11Backend::Present()
+{
+#ifdef _DEBUG
+	HRESULT hr;
+	if (FAILED(hr = pFrameManager->Present(1, 0)))
+	{
+		if (hr == DXGI_ERROR_DEVICE_REMOVED)
+		{
+			throw GFXEXCPT(pDevice->GetDeviceRemovedReason());
+		}
+		else
+		{
+			throw GFXEXCPT("Failed to present new frame to main window! Fatal application error!");
+		}
+	}
+#else
+	pFrameManager->Present(1, 0);
+#endif
+}
+
+bool D3D11Backend::ReadFrame(std::vector<Color>& pixels, int& width, int& height)
+{
+	ComPtr<ID3D11Texture2D> pBackBuffer = nullptr;
+	GFXCHECK(pFrameManager->GetBuffer(0, __uuidof(ID3D11Texture2D), &pBackBuffer));
+	D3D11_TEXTURE2D_DESC td = {};
+	pBackBuffer->GetDesc(&td);
+	td.Usage = D3D11_USAGE_STAGING;
+	td.BindFlags = 0;
+	td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	td.MiscFlags = 0;
+	ComPtr<ID3D11Texture2D> pStaging = nullptr;
+	GFXCHECK(pDevice->CreateTexture2D(&td, nullptr, &pStaging));
+	pPipeline->CopyResource(pStaging.Get(), pBackBuffer.Get());
+	D3D11_MAPPED_SUBRESOURCE readMsr = {};
+	GFXCHECK(pPipeline->Map(pStaging.Get(), 0, D3D11_MAP_READ, 0, &readMsr));
+	width = (int)td.Width;
+	height = (int)td.Height;
+	pixels.resize((size_t)width * height);
+	for (int y = 0; y < height; ++y)
+	{
+		memcpy(&pixels[(size_t)y * width], (const char*)readMsr.pData + (size_t)y * readMsr.RowPitch, width * sizeof(Color));
+	}
+	pPipeline->Unmap(pStaging.Get(), 0);
+	return true;
+}
+
+void D3D11Backend::ResizeFrame(float x_scale, float y_scale)
+{
+	pFrameBufferView.Reset();
+	GFXCHECK(pFrameManager->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0));
+	ComPtr<ID3D11Resource> pBackBuffer = nullptr;
+	GFXCHECK(pFrameManager->GetBuffer(0, __uuidof(ID3D11Resource), &pBackBuffer));
+	GFXCHECK(pDevice->CreateRenderTargetView(pBackBuffer.Get(), nullptr, pFrameBufferView.GetAddressOf()));
+	pPipeline->OMSetRenderTargets(1, pFrameBufferView.GetAddressOf(), nullptr);
+}
+
+void D3D11Backend::SetFullscreen(bool fullscreen)
+{
+	GFXCHECK(pFrameManager->SetFullscreenState(fullscreen, nullptr));
+}
+
+bool D3D11Backend::isFullscreen()
+{
+	BOOL isFullscreen;
+	GFXCHECK(pFrameManager->GetFullscreenState(&isFullscreen, nullptr));
+	return isFullscreen;
+}
+#endif
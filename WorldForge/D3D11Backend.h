@@ -0,0 +1,74 @@
+#pragma once
+#ifdef _WIN32
+#include <d3d11.h>
+#include <wrl.h>
+#include "Win32Includes.h"
+#include "GraphicsBackend.h"
+
+class D3D11Backend : public GraphicsBackend
+{
+private:
+	struct LayerResources
+	{
+		int width = 0;
+		int height = 0;
+		bool partialUploads = false;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> pPShader;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> pVShader;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> pPixelMap;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> pPixelMapView;
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> pSampler;
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> pWrapSampler;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> pPSCBUF;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> pVSCBUF;
+	};
+	struct Vertex
+	{
+		struct
+		{
+			float x;
+			float y;
+		} pos;
+		struct
+		{
+			float u;
+			float v;
+		} tc;
+	};
+	static constexpr Vertex quad[4] =
+	{
+		{ { -1.0f, 1.0f },{ 0.0f,0.0f } },
+		{ {  1.0f, 1.0f },{ 1.0f,0.0f } },
+		{ { -1.0f,-1.0f },{ 0.0f,1.0f } },
+		{ {  1.0f,-1.0f },{ 1.0f,1.0f } }
+	};
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> pDevice = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> pPipeline = nullptr;
+	Microsoft::WRL::ComPtr<IDXGISwapChain> pFrameManager = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> pFrameBufferView = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> pQuadVertices = nullptr;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> pWrappedQuadVertices = nullptr;
+	D3D11_MAPPED_SUBRESOURCE msr = {};
+	std::vector<LayerResources> Layers;
+private:
+	LayerResources& GetLayer(int layer);
+public:
+	D3D11Backend(HWND hWnd, int WindowWidth, int WindowHeight);
+	void CreateLayer(int layer, const LayerDesc& desc) override;
+	void UploadLayer(int layer, const Color* pPixels, int pitch) override;
+	void UploadLayerRegion(int layer, const Color* pPixels, int pitch, const DirtyRect& region) override;
+	void SetLayerFiltering(int layer, bool bilinear) override;
+	void SetPixelShader(const Shader& shader, int layer) override;
+	void SetVertexShader(const Shader& shader, int layer) override;
+	void CreateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) override;
+	void UpdateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) override;
+	void BeginFrame(const float4& background) override;
+	void DrawLayer(int layer, const LayerTransform& transform) override;
+	void Present() override;
+	bool ReadFrame(std::vector<Color>& pixels, int& width, int& height) override;
+	void ResizeFrame(float x_scale, float y_scale) override;
+	void SetFullscreen(bool fullscreen) override;
+	bool isFullscreen() override;
+};
+#endif
@@ -1,18 +1,51 @@
 #include "Field.h"
+#include "TileCodec.h"
+#include "MappedFile.h"
+#include <string.h>
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <type_traits>
 
 #define CHECK_XY(x, y) { assert(x >= 0 && x < fieldDim.x); assert(y >= 0 && y < fieldDim.y); }
 
+template<typename T, typename Byte>
+using CellPtr = std::conditional_t<std::is_const_v<Byte>, const T*, T*>;
+
+// hands visit the cells as an array of their stored width
+template<typename Byte, typename Visit>
+static void VisitCells(Byte* pCells, int cell_bytes, Visit&& visit)
+{
+	switch (cell_bytes)
+	{
+	case 1:
+		visit(reinterpret_cast<CellPtr<unsigned char, Byte>>(pCells));
+		break;
+	case 2:
+		visit(reinterpret_cast<CellPtr<unsigned short, Byte>>(pCells));
+		break;
+	default:
+		visit(reinterpret_cast<CellPtr<unsigned int, Byte>>(pCells));
+		break;
+	}
+}
+
 Field::Field(Graphics& gfx, std::vector<Image> images, int default_image, int layer)
 	:
 	gfx(gfx),
 	layer(layer),
 	imageDim({ images[0].GetWidth(),images[0].GetHeight() }),
 	fieldDim({ gfx.GetWidth(layer) / imageDim.x,gfx.GetHeight(layer) / imageDim.y }),
+	ringDim(fieldDim),
+	visibleDim(fieldDim),
 	images(images),
+	chunkGridWidth((fieldDim.x + chunkCells - 1) / chunkCells),
+	scroll(0, 0),
+	windowOrigin({ 0,0 }),
 	drawFlag(true)
 {
 	assert(!images.empty());
-	field.resize(fieldDim.x * fieldDim.y, default_image);
+	InitCells(default_image, {});
 	gfx.ManuallyManage(layer);
 }
 
@@ -22,17 +55,303 @@ Field::Field(Graphics& gfx, std::vector<Image> images, std::vector<int> field_da
 	layer(layer),
 	imageDim({ images[0].GetWidth(),images[0].GetHeight() }),
 	fieldDim({ gfx.GetWidth(layer) / imageDim.x,gfx.GetHeight(layer) / imageDim.y }),
+	ringDim(fieldDim),
+	visibleDim(fieldDim),
+	images(images),
+	chunkGridWidth((fieldDim.x + chunkCells - 1) / chunkCells),
+	scroll(0, 0),
+	windowOrigin({ 0,0 }),
+	drawFlag(true)
+{
+	assert(!images.empty());
+	InitCells(0, field_data);
+	gfx.ManuallyManage(layer);
+}
+
+Field::Field(Graphics& gfx, std::vector<Image> images, int2 field_dims, std::vector<int> field_data, int layer)
+	:
+	gfx(gfx),
+	layer(layer),
+	imageDim({ images[0].GetWidth(),images[0].GetHeight() }),
+	fieldDim(field_dims),
+	ringDim({ gfx.GetWidth(layer) / imageDim.x,gfx.GetHeight(layer) / imageDim.y }),
+	visibleDim({ ringDim.x - 1,ringDim.y - 1 }),
 	images(images),
+	chunkGridWidth((fieldDim.x + chunkCells - 1) / chunkCells),
+	scroll(0, 0),
+	windowOrigin({ 0,0 }),
 	drawFlag(true)
 {
 	assert(!images.empty());
-	field.resize(fieldDim.x * fieldDim.y, 0);
-	assert(field_data.size() <= field.size());
-	for (int i = 0; i < field_data.size(); ++i)
+	assert(fieldDim.x > 0 && fieldDim.y > 0);
+	assert(ringDim.x * imageDim.x == gfx.GetWidth(layer) && ringDim.y * imageDim.y == gfx.GetHeight(layer));
+	InitCells(0, field_data);
+	gfx.ManuallyManage(layer);
+}
+
+Field::Field(Graphics& gfx, std::vector<Image> images, ChunkedMap& map, int layer)
+	:
+	gfx(gfx),
+	layer(layer),
+	imageDim({ images[0].GetWidth(),images[0].GetHeight() }),
+	fieldDim(map.GetDimensions()),
+	ringDim({ gfx.GetWidth(layer) / imageDim.x,gfx.GetHeight(layer) / imageDim.y }),
+	visibleDim({ ringDim.x - 1,ringDim.y - 1 }),
+	pSource(&map),
+	images(images),
+	chunkGridWidth((fieldDim.x + chunkCells - 1) / chunkCells),
+	scroll(0, 0),
+	windowOrigin({ 0,0 }),
+	drawFlag(true)
+{
+	assert(!images.empty());
+	assert(ringDim.x * imageDim.x == gfx.GetWidth(layer) && ringDim.y * imageDim.y == gfx.GetHeight(layer));
+	gfx.ManuallyManage(layer);
+}
+
+int Field::CellBytesFor(size_t nSlots)
+{
+	return nSlots <= 0x100 ? 1 : (nSlots <= 0x10000 ? 2 : 4);
+}
+
+void Field::InitCells(int default_image, const std::vector<int>& field_data)
+{
+	const int nCells = fieldDim.x * fieldDim.y;
+	assert((int)field_data.size() <= nCells);
+	slotImage.resize(images.size());
+	std::iota(slotImage.begin(), slotImage.end(), 0);
+	imageSlot = slotImage;
+	cellBytes = CellBytesFor(images.size());
+	cells.resize((size_t)nCells * cellBytes);
+	for (int i = 0; i < nCells; ++i)
 	{
-		field[i] = field_data[i];
+		PutCell(i, i < (int)field_data.size() ? field_data[i] : default_image);
+	}
+	isCellDirty.resize(nCells, false);
+}
+
+void Field::Repack()
+{
+	// store image ids directly again, at the narrowest width that holds them
+	const int nCells = fieldDim.x * fieldDim.y;
+	const int nBytes = CellBytesFor(images.size());
+	std::vector<unsigned char> packed((size_t)nCells * nBytes);
+	VisitCells(cells.data(), cellBytes, [&](const auto* pSrc)
+	{
+		VisitCells(packed.data(), nBytes, [&](auto* pDst)
+		{
+			for (int i = 0; i < nCells; ++i)
+			{
+				pDst[i] = (std::remove_reference_t<decltype(*pDst)>)slotImage[pSrc[i]];
+			}
+		});
+	});
+	cells.swap(packed);
+	cellBytes = nBytes;
+	slotImage.resize(images.size());
+	std::iota(slotImage.begin(), slotImage.end(), 0);
+	imageSlot = slotImage;
+}
+
+int Field::GetCell(int index) const
+{
+	switch (cellBytes)
+	{
+	case 1:
+		return slotImage[cells[index]];
+	case 2:
+		return slotImage[reinterpret_cast<const unsigned short*>(cells.data())[index]];
+	default:
+		return slotImage[reinterpret_cast<const unsigned int*>(cells.data())[index]];
+	}
+}
+
+void Field::PutCell(int index, int image_id)
+{
+	assert(image_id >= 0 && image_id < (int)imageSlot.size());
+	const int slot = imageSlot[image_id];
+	switch (cellBytes)
+	{
+	case 1:
+		cells[index] = (unsigned char)slot;
+		break;
+	case 2:
+		reinterpret_cast<unsigned short*>(cells.data())[index] = (unsigned short)slot;
+		break;
+	default:
+		reinterpret_cast<unsigned int*>(cells.data())[index] = (unsigned int)slot;
+		break;
+	}
+}
+
+void Field::SetCell(int index, int image_id)
+{
+	assert(!pSource);
+	if (GetCell(index) == image_id)
+	{
+		return;
+	}
+	PutCell(index, image_id);
+	if (!isCellDirty[index])
+	{
+		isCellDirty[index] = true;
+		dirtyCells.push_back(index);
+	}
+}
+
+void Field::MarkCellsUsing(int image_id)
+{
+	if (pSource)
+	{
+		// the resident window is all that could show it, so redraw that rather than scan the map
+		drawFlag = true;
+		return;
+	}
+	const int nCells = fieldDim.x * fieldDim.y;
+	VisitCells(cells.data(), cellBytes, [&](const auto* pCells)
+	{
+		for (int i = 0; i < nCells; ++i)
+		{
+			if (slotImage[pCells[i]] == image_id && !isCellDirty[i])
+			{
+				isCellDirty[i] = true;
+				dirtyCells.push_back(i);
+			}
+		}
+	});
+}
+
+bool Field::isResident(int x, int y) const
+{
+	return
+		x >= windowOrigin.x && x < windowOrigin.x + ringDim.x &&
+		y >= windowOrigin.y && y < windowOrigin.y + ringDim.y;
+}
+
+int Field::GetCellImage(int x, int y) const
+{
+	if (pSource)
+	{
+		// streamed ids come straight from disk, so they are checked the same way Load checks its own
+		const int image_id = pSource->GetTile(x, y);
+		if (image_id < 0 || image_id >= (int)images.size())
+		{
+			throw EXCPT_NOTE("Map references an image the field does not have! Please check the file and retry.");
+		}
+		return image_id;
+	}
+	return GetCell(y * fieldDim.x + x);
+}
+
+const Image* Field::FindChunk(int cx, int cy)
+{
+	const auto it = chunkImages.find(cy * chunkGridWidth + cx);
+	if (it == chunkImages.end())
+	{
+		return nullptr;
+	}
+	chunkLru.splice(chunkLru.begin(), chunkLru, it->second.lruPosition);
+	return &it->second.image;
+}
+
+const Image& Field::BakeChunk(int cx, int cy)
+{
+	const int chunk = cy * chunkGridWidth + cx;
+	const int left = cx * chunkCells;
+	const int top = cy * chunkCells;
+	const int right = std::min(left + chunkCells, fieldDim.x);
+	const int bottom = std::min(top + chunkCells, fieldDim.y);
+	BakedChunk& baked = chunkImages[chunk];
+	baked.image = Image((right - left) * imageDim.x, (bottom - top) * imageDim.y);
+	for (int y = top; y < bottom; ++y)
+	{
+		for (int x = left; x < right; ++x)
+		{
+			baked.image.Paste(images[GetCellImage(x, y)], (x - left) * imageDim.x, (y - top) * imageDim.y);
+		}
+	}
+	chunkLru.push_front(chunk);
+	baked.lruPosition = chunkLru.begin();
+	chunkBytes += (size_t)baked.image.GetWidth() * baked.image.GetHeight() * sizeof(Color);
+	return baked.image;
+}
+
+void Field::PatchChunk(int x, int y)
+{
+	const auto it = chunkImages.find((y / chunkCells) * chunkGridWidth + x / chunkCells);
+	if (it != chunkImages.end())
+	{
+		it->second.image.Paste(images[GetCellImage(x, y)], (x % chunkCells) * imageDim.x, (y % chunkCells) * imageDim.y);
+	}
+}
+
+void Field::ClearChunks()
+{
+	chunkImages.clear();
+	chunkLru.clear();
+	chunkBytes = 0;
+}
+
+void Field::TrimChunks()
+{
+	while (chunkBytes > chunkBudget)
+	{
+		const auto it = chunkImages.find(chunkLru.back());
+		chunkBytes -= (size_t)it->second.image.GetWidth() * it->second.image.GetHeight() * sizeof(Color);
+		chunkImages.erase(it);
+		chunkLru.pop_back();
+	}
+}
+
+void Field::DrawCells(int left, int top, int right, int bottom)
+{
+	right = std::min(right, fieldDim.x);
+	bottom = std::min(bottom, fieldDim.y);
+	// split wherever a chunk ends or the ring wraps, so that each piece is a single copy of contiguous rows
+	for (int y0 = top; y0 < bottom;)
+	{
+		const int y1 = std::min({ bottom,(y0 / chunkCells + 1) * chunkCells,(y0 / ringDim.y + 1) * ringDim.y });
+		for (int x0 = left; x0 < right;)
+		{
+			const int x1 = std::min({ right,(x0 / chunkCells + 1) * chunkCells,(x0 / ringDim.x + 1) * ringDim.x });
+			const int cx = x0 / chunkCells;
+			const int cy = y0 / chunkCells;
+			const Image* pChunk = FindChunk(cx, cy);
+			// only a chunk drawn whole is worth baking, since a partial one would cost more tiles than it saves
+			if (!pChunk && chunkBudget > 0 &&
+				x0 == cx * chunkCells && x1 == std::min(x0 + chunkCells, fieldDim.x) &&
+				y0 == cy * chunkCells && y1 == std::min(y0 + chunkCells, fieldDim.y))
+			{
+				pChunk = &BakeChunk(cx, cy);
+			}
+			if (pChunk)
+			{
+				const iRect region({ (x0 % chunkCells) * imageDim.x,(y0 % chunkCells) * imageDim.y }, (x1 - x0) * imageDim.x, (y1 - y0) * imageDim.y);
+				pChunk->DrawRegion(gfx, (x0 % ringDim.x) * imageDim.x, (y0 % ringDim.y) * imageDim.y, region, layer);
+			}
+			else
+			{
+				for (int y = y0; y < y1; ++y)
+				{
+					for (int x = x0; x < x1; ++x)
+					{
+						DrawCell(x, y);
+					}
+				}
+			}
+			x0 = x1;
+		}
+		y0 = y1;
 	}
-	gfx.ManuallyManage(layer);
+}
+
+void Field::DrawCell(int x, int y)
+{
+	if (x >= fieldDim.x || y >= fieldDim.y)
+	{
+		return;
+	}
+	images[GetCellImage(x, y)].Draw(gfx, (x % ringDim.x) * imageDim.x, (y % ringDim.y) * imageDim.y, layer);
 }
 
 const int2& Field::GetFieldDimensions() const
@@ -40,47 +359,62 @@ const int2& Field::GetFieldDimensions() const
 	return fieldDim;
 }
 
-const int& Field::GetImageId(int x, int y) const
+int Field::GetImageId(int x, int y) const
 {
 	CHECK_XY(x, y);
-	return field[y * fieldDim.x + x];
+	return GetCellImage(x, y);
+}
+
+void Field::SetScroll(vec2i offset)
+{
+	// a ring's spare row and column may hang off the map, since they are never fully visible
+	scroll.x = std::clamp(offset.x, 0, std::max(0, (fieldDim.x - visibleDim.x) * imageDim.x));
+	scroll.y = std::clamp(offset.y, 0, std::max(0, (fieldDim.y - visibleDim.y) * imageDim.y));
+}
+
+void Field::Scroll(vec2i delta)
+{
+	SetScroll(scroll + delta);
+}
+
+const vec2i& Field::GetScroll() const
+{
+	return scroll;
 }
 
 void Field::UpdateField(int x, int y, int image_id)
 {
 	CHECK_XY(x, y);
-	field[y * fieldDim.x + x] = image_id;
-	drawFlag = true;
+	SetCell(y * fieldDim.x + x, image_id);
 }
 
 void Field::UpdateFieldRow(int y, std::vector<int> image_ids)
 {
 	assert(y >= 0 && y < fieldDim.y);
-	assert(image_ids.size() <= fieldDim.x);
-	for (int i = 0; i < image_ids.size(); ++i)
+	assert((int)image_ids.size() <= fieldDim.x);
+	for (int i = 0; i < (int)image_ids.size(); ++i)
 	{
-		field[y * fieldDim.x + i] = image_ids[i];
+		SetCell(y * fieldDim.x + i, image_ids[i]);
 	}
-	drawFlag = true;
 }
 
 void Field::UpdateFieldColumn(int x, std::vector<int> image_ids)
 {
 	assert(x >= 0 && x < fieldDim.x);
-	assert(image_ids.size() <= fieldDim.y);
-	for (int i = 0; i < image_ids.size(); ++i)
+	assert((int)image_ids.size() <= fieldDim.y);
+	for (int i = 0; i < (int)image_ids.size(); ++i)
 	{
-		field[i * fieldDim.x + x] = image_ids[i];
+		SetCell(i * fieldDim.x + x, image_ids[i]);
 	}
-	drawFlag = true;
 }
 
 void Field::UpdateField(std::vector<int> image_ids)
 {
-	assert(image_ids.size() <= field.size());
-	for (int i = 0; i < image_ids.size(); ++i)
+	assert(!pSource);
+	assert((int)image_ids.size() <= fieldDim.x * fieldDim.y);
+	for (int i = 0; i < (int)image_ids.size(); ++i)
 	{
-		field[i] = image_ids[i];
+		PutCell(i, image_ids[i]);
 	}
 	drawFlag = true;
 }
@@ -88,7 +422,7 @@ void Field::UpdateField(std::vector<int> image_ids)
 void Field::UpdateImage(int image_id, Image new_image)
 {
 	images[image_id] = new_image;
-	drawFlag = true;
+	MarkCellsUsing(image_id);
 }
 
 const Image& Field::GetImage(int image_id) const
@@ -99,6 +433,19 @@ const Image& Field::GetImage(int image_id) const
 void Field::AddImage(Image new_image)
 {
 	images.emplace_back(new_image);
+	if (pSource)
+	{
+		return;
+	}
+	if (CellBytesFor(slotImage.size() + 1) > cellBytes)
+	{
+		Repack();
+	}
+	else
+	{
+		imageSlot.push_back((int)slotImage.size());
+		slotImage.push_back((int)images.size() - 1);
+	}
 }
 
 void Field::RemoveImage(int image_id)
@@ -106,25 +453,148 @@ void Field::RemoveImage(int image_id)
 	auto index = images.begin();
 	index += image_id;
 	images.erase(index);
-	for (int& id : field)
+	// cells that showed the removed image now show its successor
+	if (image_id < (int)images.size())
 	{
-		if (id > image_id)
+		MarkCellsUsing(image_id);
+	}
+	if (!pSource)
+	{
+		// the removed image's slots fall through to its successor along with that image's own slots
+		imageSlot.erase(imageSlot.begin() + image_id);
+		for (int& image : slotImage)
 		{
-			--id;
+			if (image > image_id)
+			{
+				--image;
+			}
 		}
 	}
 }
 
+void Field::SetChunkCacheBudget(size_t bytes)
+{
+	chunkBudget = bytes;
+	TrimChunks();
+}
+
+void Field::Save(const char* filename) const
+{
+	assert(!pSource);
+	const int nCells = fieldDim.x * fieldDim.y;
+	std::vector<int> ids(nCells);
+	for (int i = 0; i < nCells; ++i)
+	{
+		ids[i] = GetCell(i);
+	}
+	std::vector<unsigned char> payload;
+	TileCodec::EncodeRuns(ids.data(), nCells, payload);
+	const FileHeader header = { { 'W','F','F','D' },fileVersion,fieldDim.x,fieldDim.y };
+	std::ofstream fieldOUT{ filename, std::ios::binary };
+	if (fieldOUT.fail())
+	{
+		throw EXCPT_NOTE("Cannot write to specified file! Check directory and/or file name spelling and retry.");
+	}
+	fieldOUT.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fieldOUT.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	if (fieldOUT.fail())
+	{
+		throw EXCPT_NOTE("Critical error writing field file! Please retry.");
+	}
+	fieldOUT.close();
+}
+
+void Field::Load(const char* filename)
+{
+	assert(!pSource);
+	MappedFile file(filename);
+	FileHeader header = {};
+	if (file.GetSize() < sizeof(header))
+	{
+		throw EXCPT_NOTE("File is too small to be a field! Please check the file and retry.");
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+	if (memcmp(header.magic, "WFFD", 4) != 0 || header.version != fileVersion)
+	{
+		throw EXCPT_NOTE("File is not a supported field! Please check the file and retry.");
+	}
+	if (header.width != fieldDim.x || header.height != fieldDim.y)
+	{
+		throw EXCPT_NOTE("Field file dimensions do not match this field! Please check the file and retry.");
+	}
+	// decode straight into cells of the final width; ids past the last image are rejected as corrupt
+	const int nCells = fieldDim.x * fieldDim.y;
+	const int nBytes = CellBytesFor(images.size());
+	std::vector<unsigned char> loaded((size_t)nCells * nBytes);
+	VisitCells(loaded.data(), nBytes, [&](auto* pCells)
+	{
+		TileCodec::DecodeRuns(file.GetData() + sizeof(header), file.GetSize() - sizeof(header), pCells, nCells, (unsigned int)images.size() - 1);
+	});
+	cells.swap(loaded);
+	cellBytes = nBytes;
+	slotImage.resize(images.size());
+	std::iota(slotImage.begin(), slotImage.end(), 0);
+	imageSlot = slotImage;
+	for (const int i : dirtyCells)
+	{
+		isCellDirty[i] = false;
+	}
+	dirtyCells.clear();
+	drawFlag = true;
+}
+
 void Field::Render()
 {
+	const int2 origin = { scroll.x / imageDim.x,scroll.y / imageDim.y };
+	if (pSource)
+	{
+		pSource->Update(iRect(origin, ringDim.x, ringDim.y));
+	}
 	if (drawFlag)
 	{
-		for (int i = 0; i < field.size(); ++i)
+		ClearChunks();
+	}
+	else
+	{
+		// baked chunks take in changed cells even when off-screen, so they never go stale
+		for (const int i : dirtyCells)
 		{
-			int y = i / fieldDim.x;
-			int x = i % fieldDim.x;
-			images[field[i]].Draw(gfx, x * imageDim.x, y * imageDim.y, layer);
+			PatchChunk(i % fieldDim.x, i / fieldDim.x);
 		}
+	}
+	if (drawFlag || abs(origin.x - windowOrigin.x) >= ringDim.x || abs(origin.y - windowOrigin.y) >= ringDim.y)
+	{
+		windowOrigin = origin;
+		DrawCells(origin.x, origin.y, origin.x + ringDim.x, origin.y + ringDim.y);
 		drawFlag = false;
 	}
-}
\ No newline at end of file
+	else
+	{
+		// only the strips that scrolled into the window take over the ring slots of those that left it:
+		// rows that scrolled in are drawn whole, the rows that stayed only gain the columns that scrolled in
+		const int2 previous = windowOrigin;
+		windowOrigin = origin;
+		const int newTop = origin.y < previous.y ? origin.y : previous.y + ringDim.y;
+		const int newBottom = origin.y < previous.y ? previous.y : origin.y + ringDim.y;
+		const int newLeft = origin.x < previous.x ? origin.x : previous.x + ringDim.x;
+		const int newRight = origin.x < previous.x ? previous.x : origin.x + ringDim.x;
+		DrawCells(origin.x, newTop, origin.x + ringDim.x, newBottom);
+		DrawCells(newLeft, std::max(origin.y, previous.y), newRight, std::min(origin.y, previous.y) + ringDim.y);
+		for (const int i : dirtyCells)
+		{
+			const int y = i / fieldDim.x;
+			const int x = i % fieldDim.x;
+			if (isResident(x, y))
+			{
+				DrawCell(x, y);
+			}
+		}
+	}
+	TrimChunks();
+	gfx.SetWrapOrigin(scroll, layer);
+	for (const int i : dirtyCells)
+	{
+		isCellDirty[i] = false;
+	}
+	dirtyCells.clear();
+}
@@ -1,22 +1,86 @@
 #pragma once
 #include "Image.h"
+#include "ChunkedMap.h"
+#include <unordered_map>
+#include <list>
 
 class Field
 {
+private:
+	struct FileHeader
+	{
+		char magic[4];
+		unsigned int version;
+		int width;
+		int height;
+	};
+	static constexpr unsigned int fileVersion = 1;
+	// side length, in cells, of the regions baked into cached images
+	static constexpr int chunkCells = 16;
 private:
 	Graphics& gfx;
 	int layer;
 	const int2 imageDim;
 	const int2 fieldDim;
-	std::vector<int> field;
+	const int2 ringDim;
+	// cells the window may show at once: a ring keeps one spare row and column, a screen-sized field keeps none
+	const int2 visibleDim;
+	// cells hold slots rather than image ids, stored 1, 2 or 4 bytes wide depending on how many slots exist;
+	// removing an image only remaps the slot table instead of rewriting every cell
+	std::vector<unsigned char> cells;
+	int cellBytes = 1;
+	std::vector<int> slotImage;
+	std::vector<int> imageSlot;
+	ChunkedMap* pSource = nullptr;
 	std::vector<Image> images;
+	// whole chunks of cells pre-rendered into single images, so that redrawing them copies a few long rows
+	// instead of blitting every tile; the least recently drawn are dropped once they exceed the budget
+	struct BakedChunk
+	{
+		Image image;
+		std::list<int>::iterator lruPosition;
+	};
+	std::unordered_map<int, BakedChunk> chunkImages;
+	std::list<int> chunkLru;
+	size_t chunkBytes = 0;
+	size_t chunkBudget = 32 << 20;
+	int chunkGridWidth;
+	std::vector<char> isCellDirty;
+	std::vector<int> dirtyCells;
+	vec2i scroll;
+	int2 windowOrigin;
 	bool drawFlag;
+private:
+	static int CellBytesFor(size_t nSlots);
+	void InitCells(int default_image, const std::vector<int>& field_data);
+	void Repack();
+	int GetCell(int index) const;
+	void PutCell(int index, int image_id);
+	void SetCell(int index, int image_id);
+	void MarkCellsUsing(int image_id);
+	bool isResident(int x, int y) const;
+	int GetCellImage(int x, int y) const;
+	const Image* FindChunk(int cx, int cy);
+	const Image& BakeChunk(int cx, int cy);
+	void PatchChunk(int x, int y);
+	void ClearChunks();
+	void TrimChunks();
+	void DrawCells(int left, int top, int right, int bottom);
+	void DrawCell(int x, int y);
 public:
 	Field() = delete;
 	Field(Graphics& gfx, std::vector<Image> images, int default_image = 0, int layer = 0);
 	Field(Graphics& gfx, std::vector<Image> images, std::vector<int> field_data, int layer = 0);
+	// a map larger than the layer keeps only a window of it resident, using the layer as a ring buffer of tiles;
+	// the layer's dimensions must be whole tiles and at least one tile larger than the visible area
+	Field(Graphics& gfx, std::vector<Image> images, int2 field_dims, std::vector<int> field_data, int layer = 0);
+	// streams a read-only map through the ring, decoding only the chunks around the window; the map must outlive the field
+	Field(Graphics& gfx, std::vector<Image> images, ChunkedMap& map, int layer = 0);
 	const int2& GetFieldDimensions() const;
-	const int& GetImageId(int x, int y) const;
+	int GetImageId(int x, int y) const;
+	void SetScroll(vec2i offset);
+	void Scroll(vec2i delta);
+	const vec2i& GetScroll() const;
 	void UpdateField(int x, int y, int image_id);
 	void UpdateFieldRow(int y, std::vector<int> image_ids);
 	void UpdateFieldColumn(int x, std::vector<int> image_ids);
@@ -25,5 +89,8 @@ public:
 	const Image& GetImage(int image_id) const;
 	void AddImage(Image new_image);
 	void RemoveImage(int image_id);
+	void SetChunkCacheBudget(size_t bytes);
+	void Save(const char* filename) const;
+	void Load(const char* filename);
 	void Render();
 };
@@ -1,10 +1,16 @@
 #include "Graphics.h"
+#include "D3D11Backend.h"
+#include "HeadlessBackend.h"
+#include "Image.h"
 #include "Rect.h"
 #include "Math.h"
+#include "WorkerPool.h"
+#include "PixelKernels.h"
 #include <assert.h>
-#pragma comment(lib, "d3d11.lib")
-
-using namespace Microsoft::WRL;
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <math.h>
 
 void Graphics::UpdateViewportsAndFrameManager(float win_x_scale, float win_y_scale)
 {
@@ -15,229 +21,461 @@ void Graphics::UpdateViewportsAndFrameManager(float win_x_scale, float win_y_sca
 		layer.viewport.Width *= win_x_scale;
 		layer.viewport.Height *= win_y_scale;
 	}
-	pFrameBufferView->Release();
-	GFXCHECK(pFrameManager->ResizeBuffers(0, 0, 0, DXGI_FORMAT_UNKNOWN, 0));
-	ComPtr<ID3D11Resource> pBackBuffer = nullptr;
-	GFXCHECK(pFrameManager->GetBuffer(0, __uuidof(ID3D11Resource), &pBackBuffer));
-	GFXCHECK(pDevice->CreateRenderTargetView(pBackBuffer.Get(), nullptr, pFrameBufferView.GetAddressOf()));
-	pPipeline->OMSetRenderTargets(1, pFrameBufferView.GetAddressOf(), nullptr);
+	RunOnBackend([win_x_scale, win_y_scale](GraphicsBackend& backend)
+	{
+		backend.ResizeFrame(win_x_scale, win_y_scale);
+	});
 }
 
-Graphics::Graphics(HWND hWnd, int WindowWidth, int WindowHeight, std::vector<int2> display_layer_dims)
+void Graphics::CreateLayerTexture(int layer)
 {
-	for (const int2& dld : display_layer_dims)
+	Layer& L = Layers[layer];
+	GraphicsBackend::LayerDesc desc = {};
+	desc.width = L.width;
+	desc.height = L.height;
+	desc.pPixels = L.pixelMap.data();
+	desc.partialUploads = L.isDirtyTracked;
+	std::vector<Color> expanded;
+	if (L.format != LayerFormat::BGRA8)
 	{
-		Layers.emplace_back(dld.x, dld.y);
+		expanded.resize(L.nPixels);
+		ExpandLayer(L, expanded.data(), { 0,0,L.width,L.height });
+		desc.pPixels = expanded.data();
 	}
+	SyncBackend().CreateLayer(layer, desc);
+	L.uploadedVersion = L.contentVersion;
+	L.uploadRects.clear();
+}
 
-	DXGI_SWAP_CHAIN_DESC scd = {};
-	scd.BufferCount = 2;
-	scd.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-	scd.BufferDesc.Width = WindowWidth;
-	scd.BufferDesc.Height = WindowHeight;
-	scd.BufferDesc.RefreshRate.Numerator = 0;
-	scd.BufferDesc.RefreshRate.Denominator = 1;
-	scd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
-	scd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
-	scd.Flags = 0;
-	scd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	scd.OutputWindow = hWnd;
-	scd.SampleDesc.Count = 1;
-	scd.SampleDesc.Quality = 0;
-	scd.Windowed = TRUE;
-	scd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-
-	UINT dxFlags = 0;
-
-#ifdef _DEBUG
-	dxFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
+void Graphics::RunOnBackend(std::function<void(GraphicsBackend&)> job) const
+{
+	if (pSubmitter)
+	{
+		GraphicsBackend* const pTarget = pBackend.get();
+		pSubmitter->Submit([pTarget, job = std::move(job)]()
+		{
+			job(*pTarget);
+		});
+	}
+	else
+	{
+		job(*pBackend);
+	}
+}
 
-	GFXCHECK(D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, dxFlags, nullptr, 0, D3D11_SDK_VERSION, &scd, &pFrameManager, &pDevice, nullptr, &pPipeline));
+GraphicsBackend& Graphics::SyncBackend() const
+{
+	if (pSubmitter)
+	{
+		pSubmitter->WaitIdle();
+	}
+	return *pBackend;
+}
 
-	ComPtr<ID3D11Resource> pBackBuffer = nullptr;
-	GFXCHECK(pFrameManager->GetBuffer(0, __uuidof(ID3D11Resource), &pBackBuffer));
-	GFXCHECK(pDevice->CreateRenderTargetView(pBackBuffer.Get(), nullptr, &pFrameBufferView));
+void Graphics::CreateConstantBuffer(GraphicsBackend::ShaderStage stage, const void* pData, int size, int layer)
+{
+	const std::vector<char> data((const char*)pData, (const char*)pData + size);
+	RunOnBackend([stage, data, layer](GraphicsBackend& backend)
+	{
+		backend.CreateConstantBuffer(stage, data.data(), (int)data.size(), layer);
+	});
+}
 
-	pPipeline->OMSetRenderTargets(1, pFrameBufferView.GetAddressOf(), nullptr);
+void Graphics::UpdateConstantBuffer(GraphicsBackend::ShaderStage stage, const void* pData, int size, int layer) const
+{
+	if (!pSubmitter)
+	{
+		pBackend->UpdateConstantBuffer(stage, pData, size, layer);
+		return;
+	}
+	const std::vector<char> data((const char*)pData, (const char*)pData + size);
+	RunOnBackend([stage, data, layer](GraphicsBackend& backend)
+	{
+		backend.UpdateConstantBuffer(stage, data.data(), (int)data.size(), layer);
+	});
+}
 
-	ComPtr<ID3D11Buffer> pBuffer;
-	D3D11_BUFFER_DESC bd = {};
-	D3D11_SUBRESOURCE_DATA sd = {};
+const Color* Graphics::StageLayer(Layer& L, int slot)
+{
+	if (L.format != LayerFormat::BGRA8)
+	{
+		// compact layers always need expanding, so the synchronous path borrows the first slot for it
+		std::vector<Color>& expanded = L.staging[pSubmitter ? slot : 0];
+		expanded.resize(L.nPixels);
+		if (L.isDirtyTracked)
+		{
+			for (const DirtyRect& r : L.uploadRects)
+			{
+				ExpandLayer(L, expanded.data(), r);
+			}
+		}
+		else
+		{
+			ExpandLayer(L, expanded.data(), { 0,0,L.width,L.height });
+		}
+		return expanded.data();
+	}
+	if (!pSubmitter)
+	{
+		return L.pixelMap.data();
+	}
+	std::vector<Color>& staging = L.staging[slot];
+	staging.resize(L.nPixels);
+	// always copied rather than swapped, since callers may hold on to pointers into the layer's pixel map
+	if (L.isDirtyTracked)
+	{
+		for (const DirtyRect& r : L.uploadRects)
+		{
+			for (int y = r.top; y < r.bottom; ++y)
+			{
+				memcpy(&staging[y * L.width + r.left], &L.pixelMap[y * L.width + r.left], (r.right - r.left) * sizeof(Color));
+			}
+		}
+	}
+	else
+	{
+		memcpy(staging.data(), L.pixelMap.data(), L.nImageBytes);
+	}
+	return staging.data();
+}
 
-	struct Vertex
+void Graphics::ExpandLayer(const Layer& L, Color* pDst, const DirtyRect& region)
+{
+	const int count = region.right - region.left;
+	for (int y = region.top; y < region.bottom; ++y)
 	{
-		struct
+		const int pxl = y * L.width + region.left;
+		if (L.format == LayerFormat::Indexed8)
 		{
-			float x;
-			float y;
-		} pos;
-		struct
+			PixelKernels::ExpandIndexedRow(&pDst[pxl], &L.indexMap[pxl], L.palette.data(), count);
+		}
+		else
 		{
-			float u;
-			float v;
-		} tc;
-	};
-	Vertex VBuffer[4] = 
-	{ 
-		{ { -1.0f, 1.0f },{ 0.0f,0.0f } },
-		{ {  1.0f, 1.0f },{ 1.0f,0.0f } },
-		{ { -1.0f,-1.0f },{ 0.0f,1.0f } },
-		{ {  1.0f,-1.0f },{ 1.0f,1.0f } } 
-	};
-	bd = {};
-	bd.ByteWidth = UINT(std::size(VBuffer) * sizeof(Vertex));
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	bd.MiscFlags = 0;
-	bd.StructureByteStride = sizeof(Vertex);
-	sd = {};
-	sd.pSysMem = VBuffer;
-	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &pBuffer));
-	UINT offset = 0;
-	pPipeline->IASetVertexBuffers(0, 1, pBuffer.GetAddressOf(), &bd.StructureByteStride, &offset);
-
-	unsigned short IBuffer[6] = { 2,0,1, 1,3,2 };
-	bd = {};
-	bd.ByteWidth = UINT(std::size(IBuffer) * sizeof(unsigned short));
-	bd.Usage = D3D11_USAGE_DEFAULT;
-	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	bd.MiscFlags = 0;
-	bd.StructureByteStride = sizeof(unsigned short);
-	sd = {};
-	sd.pSysMem = IBuffer;
-	GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &pBuffer));
-	pPipeline->IASetIndexBuffer(pBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-
-	ComPtr<ID3D11InputLayout> pILayout = nullptr;
-	D3D11_INPUT_ELEMENT_DESC ied[2];
-	ied[0].AlignedByteOffset = 0;
-	ied[0].Format = DXGI_FORMAT_R32G32_FLOAT;
-	ied[0].InputSlot = 0;
-	ied[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	ied[0].InstanceDataStepRate = 0;
-	ied[0].SemanticIndex = 0;
-	ied[0].SemanticName = "Position";
-	ied[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	ied[1].Format = DXGI_FORMAT_R32G32_FLOAT;
-	ied[1].InputSlot = 0;
-	ied[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	ied[1].InstanceDataStepRate = 0;
-	ied[1].SemanticIndex = 0;
-	ied[1].SemanticName = "TextureCoordinate";
-	GFXCHECK(pDevice->CreateInputLayout(ied, (UINT)std::size(ied), VSS::Default.GetByteCode(), VSS::Default.GetByteCodeSize(), &pILayout));
-	pPipeline->IASetInputLayout(pILayout.Get());
-
-	ComPtr<ID3D11BlendState> pColorBlender = nullptr;
-	D3D11_BLEND_DESC bld = {};
-	bld.AlphaToCoverageEnable = FALSE;
-	bld.IndependentBlendEnable = FALSE;
-	bld.RenderTarget[0].BlendEnable = TRUE;
-	bld.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
-	bld.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
-	bld.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
-	bld.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_DEST_ALPHA;
-	bld.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
-	bld.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
-	bld.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
-	GFXCHECK(pDevice->CreateBlendState(&bld, &pColorBlender));
-	pPipeline->OMSetBlendState(pColorBlender.Get(), nullptr, 0xFFFFFFFF);
-
-	pPipeline->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			PixelKernels::ExpandRGB565Row(&pDst[pxl], &L.packedMap[pxl], count);
+		}
+	}
+}
 
-	for (Layer& layer : Layers)
+void Graphics::SubmitFrame(GraphicsBackend& backend, const std::vector<LayerSubmission>& submissions, const std::string& dump_filename)
+{
+	for (const LayerSubmission& submission : submissions)
 	{
-		GFXCHECK(pDevice->CreatePixelShader(PSS::Default.GetByteCode(), PSS::Default.GetByteCodeSize(), nullptr, &layer.pPShader));
-		GFXCHECK(pDevice->CreateVertexShader(VSS::Default.GetByteCode(), VSS::Default.GetByteCodeSize(), nullptr, &layer.pVShader));
-		D3D11_TEXTURE2D_DESC td = {};
-		td.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-		td.ArraySize = 1;
-		td.MipLevels = 1;
-		td.Usage = D3D11_USAGE_DYNAMIC;
-		td.SampleDesc.Count = 1;
-		td.SampleDesc.Quality = 0;
-		td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		td.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		td.Width = layer.width;
-		td.Height = layer.height;
-		D3D11_SUBRESOURCE_DATA sd = {};
-		sd.pSysMem = layer.pixelMap.data();
-		sd.SysMemPitch = layer.nImagePitchBytes;
-		GFXCHECK(pDevice->CreateTexture2D(&td, &sd, &layer.pPixelMap));
-		D3D11_SHADER_RESOURCE_VIEW_DESC vd = {};
-		vd.Format = td.Format;
-		vd.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		vd.Texture2D.MipLevels = 1;
-		vd.Texture2D.MostDetailedMip = 0;
-		GFXCHECK(pDevice->CreateShaderResourceView(layer.pPixelMap.Get(), &vd, &layer.pPixelMapView));
-		D3D11_SAMPLER_DESC smd = {};
-		smd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-		smd.AddressV = smd.AddressU;
-		smd.AddressW = smd.AddressV;
-		smd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-		GFXCHECK(pDevice->CreateSamplerState(&smd, &layer.pSampler));
+		if (submission.isFullUpload)
+		{
+			backend.UploadLayer(submission.layer, submission.pPixels, submission.pitch);
+		}
+		for (const DirtyRect& r : submission.regions)
+		{
+			backend.UploadLayerRegion(submission.layer, submission.pPixels, submission.pitch, r);
+		}
+		backend.DrawLayer(submission.layer, submission.transform);
+	}
+	if (!dump_filename.empty())
+	{
+		ReadFrameImage(backend).Save(dump_filename.c_str());
+	}
+	backend.Present();
+}
+
+Image Graphics::ReadFrameImage(GraphicsBackend& backend)
+{
+	std::vector<Color> pixels;
+	int width = 0;
+	int height = 0;
+	if (!backend.ReadFrame(pixels, width, height))
+	{
+		throw GFXEXCPT("Failed to read back the current frame!");
+	}
+	return Image(pixels, width);
+}
+
+void Graphics::AddDirtyRect(std::vector<DirtyRect>& rects, const DirtyRect& rect)
+{
+	constexpr size_t maxRects = 16;
+	DirtyRect merged = rect;
+	for (size_t i = 0; i < rects.size();)
+	{
+		const DirtyRect& r = rects[i];
+		if (merged.left >= r.left && merged.top >= r.top && merged.right <= r.right && merged.bottom <= r.bottom)
+		{
+			return;
+		}
+		if (merged.left <= r.right && r.left <= merged.right && merged.top <= r.bottom && r.top <= merged.bottom)
+		{
+			merged.left = std::min(merged.left, r.left);
+			merged.top = std::min(merged.top, r.top);
+			merged.right = std::max(merged.right, r.right);
+			merged.bottom = std::max(merged.bottom, r.bottom);
+			rects[i] = rects.back();
+			rects.pop_back();
+			i = 0;
+		}
+		else
+		{
+			++i;
+		}
+	}
+	if (rects.size() == maxRects)
+	{
+		for (const DirtyRect& r : rects)
+		{
+			merged.left = std::min(merged.left, r.left);
+			merged.top = std::min(merged.top, r.top);
+			merged.right = std::max(merged.right, r.right);
+			merged.bottom = std::max(merged.bottom, r.bottom);
+		}
+		rects.clear();
+	}
+	rects.push_back(merged);
+}
+
+#ifdef _WIN32
+Graphics::Graphics(HWND hWnd, int WindowWidth, int WindowHeight, std::vector<int2> display_layer_dims)
+	:
+	Graphics(std::make_unique<D3D11Backend>(hWnd, WindowWidth, WindowHeight), WindowWidth, WindowHeight, display_layer_dims)
+{}
+#endif
+
+Graphics::Graphics(int FrameWidth, int FrameHeight, std::vector<int2> display_layer_dims)
+	:
+	Graphics(std::make_unique<HeadlessBackend>(FrameWidth, FrameHeight), FrameWidth, FrameHeight, display_layer_dims)
+{}
+
+Graphics::Graphics(std::unique_ptr<GraphicsBackend> backend, int FrameWidth, int FrameHeight, std::vector<int2> display_layer_dims)
+	:
+	pBackend(std::move(backend))
+{
+	assert(pBackend);
+	for (const int2& dld : display_layer_dims)
+	{
+		Layers.emplace_back(dld.x, dld.y);
+	}
+	for (int i = 0; i < (int)Layers.size(); ++i)
+	{
+		Layer& layer = Layers[i];
+		CreateLayerTexture(i);
 		layer.viewport.TopLeftX = 0.0f;
 		layer.viewport.TopLeftY = 0.0f;
-		layer.viewport.Width = (float)WindowWidth;
-		layer.viewport.Height = (float)WindowHeight;
-		layer.viewport.MaxDepth = 1.0f;
-		layer.viewport.MinDepth = 0.0f;
+		layer.viewport.Width = (float)FrameWidth;
+		layer.viewport.Height = (float)FrameHeight;
 	}
 }
 
+Graphics::~Graphics()
+{
+	pSubmitter.reset();
+}
+
 void Graphics::NewFrame()
 {
+	frameStats = FrameStats();
+	clearTiles.clear();
+	const auto addClearTiles = [&](Layer& layer, const DirtyRect& r)
+	{
+		const int rowBytes = (r.right - r.left) * (layer.nImagePitchBytes / layer.width);
+		const int rowsPerTile = std::max(1, clearTileBytes / rowBytes);
+		for (int y = r.top; y < r.bottom; y += rowsPerTile)
+		{
+			clearTiles.push_back({ layer.GetPixelPtr(r.left, y),rowBytes,layer.nImagePitchBytes,std::min(rowsPerTile, r.bottom - y) });
+		}
+		frameStats.bytesCleared += (long long)rowBytes * (r.bottom - r.top);
+	};
 	for (Layer& layer : Layers)
 	{
 		if (layer.isAutoManaged)
 		{
-			memset(layer.pixelMap.data(), 0, layer.nImageBytes);
+			if (layer.isDirtyTracked)
+			{
+				for (const DirtyRect& r : layer.clearRects)
+				{
+					addClearTiles(layer, r);
+				}
+				if (!layer.clearRects.empty())
+				{
+					++layer.contentVersion;
+				}
+			}
+			else if (!layer.isCleared)
+			{
+				addClearTiles(layer, { 0,0,layer.width,layer.height });
+				++layer.contentVersion;
+				layer.isCleared = true;
+			}
 		}
 	}
-	pPipeline->ClearRenderTargetView(pFrameBufferView.Get(), &fBackgroundColorRGBA.x);
+	WorkerPool::Shared().ParallelFor((int)clearTiles.size(), [this](int i)
+	{
+		const ClearTile& tile = clearTiles[i];
+		if (tile.rowBytes == tile.pitch)
+		{
+			memset(tile.pFirstRow, 0, (size_t)tile.rowBytes * tile.nRows);
+			return;
+		}
+		char* pRow = tile.pFirstRow;
+		for (int y = 0; y < tile.nRows; ++y, pRow += tile.pitch)
+		{
+			memset(pRow, 0, tile.rowBytes);
+		}
+	});
+	const float4 background = fBackgroundColorRGBA;
+	RunOnBackend([background](GraphicsBackend& backend)
+	{
+		backend.BeginFrame(background);
+	});
 }
 
-void Graphics::EndFrame() const
+void Graphics::EndFrame()
 {
-	for (const Layer& layer : Layers)
+	FlushCommands();
+	const int slot = (int)(nFramesEnded++ % stagingRingSize);
+	if (pSubmitter)
 	{
-#ifdef _DEBUG
-		GFXCHECK(pPipeline->Map(layer.pPixelMap.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
-#else
-		pPipeline->Map(layer.pPixelMap.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr);
-#endif
-		if (layer.renderFlag)
-		{
-			memcpy(msr.pData, layer.pixelMap.data(), layer.nImageBytes);
-			pPipeline->Unmap(layer.pPixelMap.Get(), 0);
-			pPipeline->PSSetShader(layer.pPShader.Get(), nullptr, 0);
-			pPipeline->PSSetConstantBuffers(0, 1, layer.pPSCBUF.GetAddressOf());
-			pPipeline->VSSetShader(layer.pVShader.Get(), nullptr, 0);
-			pPipeline->VSSetConstantBuffers(0, 1, layer.pVSCBUF.GetAddressOf());
-			pPipeline->PSSetShaderResources(0, 1, layer.pPixelMapView.GetAddressOf());
-			pPipeline->PSSetSamplers(0, 1, layer.pSampler.GetAddressOf());
-			pPipeline->RSSetViewports(1, &layer.viewport);
-			pPipeline->DrawIndexed(6, 0, 0);
-		}
+		// a staging slot is only rewritten once the frame that last read from it has been submitted
+		pSubmitter->Wait(stagingFences[slot]);
 	}
-#ifdef _DEBUG
-	HRESULT hr;
-	if (FAILED(hr = pFrameManager->Present(1, 0)))
+	std::vector<LayerSubmission> submissions;
+	for (int i = 0; i < (int)Layers.size(); ++i)
 	{
-		if (hr == DXGI_ERROR_DEVICE_REMOVED)
+		Layer& layer = Layers[i];
+		// hidden layers keep collecting upload regions so their texture catches up once they are shown again
+		if (layer.isDirtyTracked)
+		{
+			for (const DirtyRect& r : layer.dirtyRects)
+			{
+				AddDirtyRect(layer.uploadRects, r);
+			}
+			for (const DirtyRect& r : layer.clearRects)
+			{
+				AddDirtyRect(layer.uploadRects, r);
+			}
+			layer.clearRects.clear();
+			if (layer.isAutoManaged)
+			{
+				layer.clearRects.swap(layer.dirtyRects);
+			}
+			layer.dirtyRects.clear();
+		}
+		if (!layer.renderFlag)
+		{
+			continue;
+		}
+		LayerSubmission submission = { i,nullptr,layer.width * (int)sizeof(Color),false,{},{ layer.viewport,layer.position,layer.rotation,layer.scale,layer.wrapOrigin } };
+		if (layer.contentVersion == layer.uploadedVersion)
 		{
-			throw GFXEXCPT(pDevice->GetDeviceRemovedReason());
+			++frameStats.layersSkipped;
 		}
 		else
 		{
-			throw GFXEXCPT("Failed to present new frame to main window! Fatal application error!");
+			submission.pPixels = StageLayer(layer, slot);
+			if (layer.isDirtyTracked)
+			{
+				for (const DirtyRect& r : layer.uploadRects)
+				{
+					frameStats.bytesUploaded += (long long)(r.right - r.left) * (r.bottom - r.top) * (long long)sizeof(Color);
+				}
+				submission.regions.swap(layer.uploadRects);
+			}
+			else
+			{
+				submission.isFullUpload = true;
+				frameStats.bytesUploaded += (long long)layer.nPixels * (long long)sizeof(Color);
+			}
+			layer.uploadedVersion = layer.contentVersion;
+			++frameStats.layersUploaded;
+		}
+		submissions.push_back(std::move(submission));
+	}
+	std::string dumpFilename;
+	if (!frameDumpPrefix.empty())
+	{
+		char index[16];
+		snprintf(index, sizeof(index), "%06d", frameDumpIndex++);
+		dumpFilename = frameDumpPrefix + index + ".bmp";
+	}
+	if (pSubmitter)
+	{
+		GraphicsBackend* const pTarget = pBackend.get();
+		lastFrameFence = pSubmitter->Submit([pTarget, submissions = std::move(submissions), dumpFilename]()
+		{
+			SubmitFrame(*pTarget, submissions, dumpFilename);
+		});
+		stagingFences[slot] = lastFrameFence;
+	}
+	else
+	{
+		SubmitFrame(*pBackend, submissions, dumpFilename);
+	}
+}
+
+Image Graphics::CaptureFrame() const
+{
+	return ReadFrameImage(SyncBackend());
+}
+
+void Graphics::EnableFrameDump(const std::string& filename_prefix)
+{
+	assert(!filename_prefix.empty());
+	frameDumpPrefix = filename_prefix;
+	frameDumpIndex = 0;
+}
+
+void Graphics::DisableFrameDump()
+{
+	frameDumpPrefix.clear();
+}
+
+GraphicsBackend& Graphics::GetBackend()
+{
+	return SyncBackend();
+}
+
+void Graphics::EnableAsyncSubmission()
+{
+	if (!pSubmitter)
+	{
+		pSubmitter = std::make_unique<SubmissionThread>();
+		std::fill(std::begin(stagingFences), std::end(stagingFences), 0ull);
+		lastFrameFence = 0;
+	}
+}
+
+void Graphics::DisableAsyncSubmission()
+{
+	if (pSubmitter)
+	{
+		pSubmitter->WaitIdle();
+		pSubmitter.reset();
+		for (Layer& L : Layers)
+		{
+			for (std::vector<Color>& staging : L.staging)
+			{
+				staging = std::vector<Color>();
+			}
 		}
 	}
-#else
-	pFrameManager->Present(1, 0);
-#endif
+}
+
+bool Graphics::isSubmittingAsync() const
+{
+	return (bool)pSubmitter;
+}
+
+unsigned long long Graphics::GetFrameFence() const
+{
+	return pSubmitter ? lastFrameFence : 0;
+}
+
+bool Graphics::isFrameComplete(unsigned long long fence) const
+{
+	return !pSubmitter || pSubmitter->isComplete(fence);
+}
+
+void Graphics::WaitForFrame(unsigned long long fence) const
+{
+	if (pSubmitter)
+	{
+		pSubmitter->Wait(fence);
+	}
 }
 
 const bool& Graphics::isAutoManaged(int layer) const
@@ -257,7 +495,19 @@ void Graphics::ManuallyManage(int layer)
 
 void Graphics::Erase(int layer)
 {
-	memset(Layers[layer].pixelMap.data(), 0, Layers[layer].nImageBytes);
+	Layer& L = Layers[layer];
+	if (L.isCleared)
+	{
+		return;
+	}
+	memset(L.GetPixelPtr(0, 0), 0, L.nImageBytes);
+	frameStats.bytesCleared += L.nImageBytes;
+	if (L.isDirtyTracked)
+	{
+		AddDirtyRect(L.dirtyRects, { 0,0,L.width,L.height });
+	}
+	++L.contentVersion;
+	L.isCleared = true;
 }
 
 const bool& Graphics::isBeingRendered(int layer) const
@@ -275,24 +525,140 @@ void Graphics::StopRendering(int layer)
 	Layers[layer].renderFlag = false;
 }
 
+const bool& Graphics::isDirtyTracked(int layer) const
+{
+	return Layers[layer].isDirtyTracked;
+}
+
+void Graphics::EnableDirtyTracking(int layer)
+{
+	Layer& L = Layers[layer];
+	if (!L.isDirtyTracked)
+	{
+		L.isDirtyTracked = true;
+		CreateLayerTexture(layer);
+		L.dirtyRects.clear();
+		L.clearRects.clear();
+		L.clearRects.push_back({ 0,0,L.width,L.height });
+	}
+}
+
+void Graphics::DisableDirtyTracking(int layer)
+{
+	Layer& L = Layers[layer];
+	if (L.isDirtyTracked)
+	{
+		L.isDirtyTracked = false;
+		CreateLayerTexture(layer);
+		L.dirtyRects.clear();
+		L.clearRects.clear();
+	}
+}
+
+void Graphics::SetLayerFormat(LayerFormat format, int layer)
+{
+	Layer& L = Layers[layer];
+	if (L.format == format)
+	{
+		return;
+	}
+	L.format = format;
+	L.pixelMap = std::vector<Color>();
+	L.indexMap = std::vector<unsigned char>();
+	L.packedMap = std::vector<unsigned short>();
+	int bytesPerPixel = 0;
+	switch (format)
+	{
+	case LayerFormat::Indexed8:
+		L.indexMap.resize(L.nPixels, 0);
+		if (L.palette.empty())
+		{
+			L.palette.resize(256, Colors::Transparent);
+		}
+		bytesPerPixel = (int)sizeof(unsigned char);
+		break;
+	case LayerFormat::RGB565:
+		L.packedMap.resize(L.nPixels, 0);
+		bytesPerPixel = (int)sizeof(unsigned short);
+		break;
+	default:
+		L.pixelMap.resize(L.nPixels, Colors::Transparent);
+		bytesPerPixel = (int)sizeof(Color);
+		break;
+	}
+	L.nImageBytes = L.nPixels * bytesPerPixel;
+	L.nImagePitchBytes = L.width * bytesPerPixel;
+	L.isCleared = true;
+	++L.contentVersion;
+	CreateLayerTexture(layer);
+	if (L.isDirtyTracked)
+	{
+		L.dirtyRects.clear();
+		L.clearRects.clear();
+		L.clearRects.push_back({ 0,0,L.width,L.height });
+	}
+}
+
+const Graphics::LayerFormat& Graphics::GetLayerFormat(int layer) const
+{
+	return Layers[layer].format;
+}
+
+void Graphics::SetLayerPalette(const std::vector<Color>& palette, int layer)
+{
+	Layer& L = Layers[layer];
+	assert(L.format == LayerFormat::Indexed8);
+	assert(!palette.empty() && palette.size() <= 256);
+	// unused entries stay transparent so that every index is safe to expand
+	L.palette = palette;
+	L.palette.resize(256, Colors::Transparent);
+	MarkDirty(GetRect(layer), layer);
+}
+
+const std::vector<Color>& Graphics::GetLayerPalette(int layer) const
+{
+	return Layers[layer].palette;
+}
+
+void Graphics::MarkDirty(const iRect& region, int layer)
+{
+	Layer& L = Layers[layer];
+	L.Modified();
+	if (L.isDirtyTracked)
+	{
+		const DirtyRect r =
+		{
+			std::max(region.pos.x, 0),
+			std::max(region.pos.y, 0),
+			std::min(region.pos.x + region.width, L.width),
+			std::min(region.pos.y + region.height, L.height)
+		};
+		if (r.left < r.right && r.top < r.bottom)
+		{
+			AddDirtyRect(L.dirtyRects, r);
+		}
+	}
+}
+
+const Graphics::FrameStats& Graphics::GetFrameStats() const
+{
+	return frameStats;
+}
+
 void Graphics::EnableBilinearFiltering(int layer)
 {
-	D3D11_SAMPLER_DESC smd = {};
-	smd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	smd.AddressV = smd.AddressU;
-	smd.AddressW = smd.AddressV;
-	smd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	GFXCHECK(pDevice->CreateSamplerState(&smd, &Layers[layer].pSampler));
+	RunOnBackend([layer](GraphicsBackend& backend)
+	{
+		backend.SetLayerFiltering(layer, true);
+	});
 }
 
 void Graphics::DisableBilinearFiltering(int layer)
 {
-	D3D11_SAMPLER_DESC smd = {};
-	smd.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	smd.AddressV = smd.AddressU;
-	smd.AddressW = smd.AddressV;
-	smd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-	GFXCHECK(pDevice->CreateSamplerState(&smd, &Layers[layer].pSampler));
+	RunOnBackend([layer](GraphicsBackend& backend)
+	{
+		backend.SetLayerFiltering(layer, false);
+	});
 }
 
 int Graphics::GetLayerCount() const
@@ -302,237 +668,792 @@ int Graphics::GetLayerCount() const
 
 void Graphics::SetPixelShader(const Shader& shader, int layer)
 {
-	GFXCHECK(pDevice->CreatePixelShader(shader.GetByteCode(), shader.GetByteCodeSize(), nullptr, &Layers[layer].pPShader));
+	RunOnBackend([shader, layer](GraphicsBackend& backend)
+	{
+		backend.SetPixelShader(shader, layer);
+	});
 }
 
 void Graphics::SetVertexShader(const Shader& shader, int layer)
 {
-	GFXCHECK(pDevice->CreateVertexShader(shader.GetByteCode(), shader.GetByteCodeSize(), nullptr, &Layers[layer].pVShader));
+	RunOnBackend([shader, layer](GraphicsBackend& backend)
+	{
+		backend.SetVertexShader(shader, layer);
+	});
 }
 
 void Graphics::SetPixel(int x, int y, Color color, int layer)
 {
 	Layer& L = Layers[layer];
 	assert(x < L.width && y < L.height);
+	assert(L.format != LayerFormat::Indexed8);
 	const int pxl = y * L.width + x;
-	L.pixelMap[pxl] = color;
+	if (L.format == LayerFormat::RGB565)
+	{
+		PixelKernels::PackRGB565Row(&L.packedMap[pxl], &color, 1);
+	}
+	else
+	{
+		L.pixelMap[pxl] = color;
+	}
+	L.Modified();
+	if (L.isDirtyTracked)
+	{
+		AddDirtyRect(L.dirtyRects, { x,y,x + 1,y + 1 });
+	}
 }
 
 const Color& Graphics::GetPixel(int x, int y, int layer) const
 {
 	const Layer& L = Layers[layer];
 	assert(x < L.width && y < L.height);
+	assert(L.format == LayerFormat::BGRA8);
 	const int pxl = y * L.width + x;
 	return L.pixelMap[pxl];
 }
 
-void Graphics::DrawLine(vec2i p0, vec2i p1, const Color& color, int layer)
+void Graphics::SetIndex(int x, int y, unsigned char index, int layer)
+{
+	Layer& L = Layers[layer];
+	assert(x < L.width && y < L.height);
+	assert(L.format == LayerFormat::Indexed8);
+	L.indexMap[y * L.width + x] = index;
+	L.Modified();
+	if (L.isDirtyTracked)
+	{
+		AddDirtyRect(L.dirtyRects, { x,y,x + 1,y + 1 });
+	}
+}
+
+unsigned char Graphics::GetIndex(int x, int y, int layer) const
+{
+	const Layer& L = Layers[layer];
+	assert(x < L.width && y < L.height);
+	assert(L.format == LayerFormat::Indexed8);
+	return L.indexMap[y * L.width + x];
+}
+
+static int OutCode(vec2i p, int width, int height)
+{
+	return
+		(p.x < 0) |
+		((p.x >= width) << 1) |
+		((p.y < 0) << 2) |
+		((p.y >= height) << 3);
+}
+
+static long long FloorDiv(long long a, long long b)
+{
+	return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static long long CeilDiv(long long a, long long b)
 {
-	assert(p0 != p1);
-	const iRect gfxRect = GetRect(layer);
-	if (p0.x == p1.x)
+	return -FloorDiv(-a, b);
+}
+
+bool Graphics::ClipLine(vec2i p0, vec2i p1, const DirtyRect& clip, LineStepper& line)
+{
+	p0 = { p0.x - clip.left,p0.y - clip.top };
+	p1 = { p1.x - clip.left,p1.y - clip.top };
+	const int clipWidth = clip.right - clip.left;
+	const int clipHeight = clip.bottom - clip.top;
+	const int code0 = OutCode(p0, clipWidth, clipHeight);
+	const int code1 = OutCode(p1, clipWidth, clipHeight);
+	if (code0 & code1)
+	{
+		return false;
+	}
+	const int dx = abs(p1.x - p0.x);
+	const int dy = abs(p1.y - p0.y);
+	const int sx = p1.x < p0.x ? -1 : 1;
+	const int sy = p1.y < p0.y ? -1 : 1;
+	const bool xMajor = dx >= dy;
+	const long long major = xMajor ? dx : dy;
+	const long long minor = xMajor ? dy : dx;
+	const int majorStart = xMajor ? p0.x : p0.y;
+	const int minorStart = xMajor ? p0.y : p0.x;
+	const int majorSign = xMajor ? sx : sy;
+	const int minorSign = xMajor ? sy : sx;
+	const int majorLimit = xMajor ? clipWidth : clipHeight;
+	const int minorLimit = xMajor ? clipHeight : clipWidth;
+	long long first = 0;
+	long long last = major;
+	if (code0 | code1)
 	{
-		int deltaY = 1;
-		if (p1.y < p0.y)
+		const auto clipMajor = [&](long long lo, long long hi)
 		{
-			deltaY = -1;
-		}
-		for (int y = p0.y; y != p1.y; y += deltaY)
+			const long long a = majorSign > 0 ? lo - majorStart : majorStart - hi;
+			const long long b = majorSign > 0 ? hi - majorStart : majorStart - lo;
+			first = std::max(first, a);
+			last = std::min(last, b);
+		};
+		clipMajor(0, majorLimit - 1);
+		const long long lo = minorSign > 0 ? 0 - minorStart : minorStart - (minorLimit - 1);
+		const long long hi = minorSign > 0 ? (minorLimit - 1) - minorStart : minorStart;
+		if (minor == 0)
 		{
-			if (gfxRect.ContainsPoint({ p0.x,y }))
+			if (lo > 0 || hi < 0)
 			{
-				SetPixel(p0.x, y, color, layer);
+				return false;
 			}
 		}
+		else
+		{
+			first = std::max(first, CeilDiv(2 * major * lo - major, 2 * minor));
+			last = std::min(last, FloorDiv(2 * major * (hi + 1) - major - 1, 2 * minor));
+		}
+		if (first > last)
+		{
+			return false;
+		}
+	}
+	const long long offset = 2 * first * minor + major;
+	const long long minorOffset = major ? offset / (2 * major) : 0;
+	const int majorPos = majorStart + majorSign * (int)first;
+	const int minorPos = minorStart + minorSign * (int)minorOffset;
+	line.x = (xMajor ? majorPos : minorPos) + clip.left;
+	line.y = (xMajor ? minorPos : majorPos) + clip.top;
+	line.count = (int)(last - first + 1);
+	line.majorX = xMajor ? sx : 0;
+	line.majorY = xMajor ? 0 : sy;
+	line.minorX = xMajor ? 0 : sx;
+	line.minorY = xMajor ? sy : 0;
+	line.errorStep = 2 * minor;
+	line.errorWrap = major ? 2 * major : 1;
+	line.error = major ? offset % (2 * major) : 0;
+	const int endMajorPos = majorStart + majorSign * (int)last;
+	const int endMinorPos = minorStart + minorSign * (int)(major ? (2 * last * minor + major) / (2 * major) : 0);
+	line.endX = (xMajor ? endMajorPos : endMinorPos) + clip.left;
+	line.endY = (xMajor ? endMinorPos : endMajorPos) + clip.top;
+	return true;
+}
+
+bool Graphics::BeginLine(vec2i p0, vec2i p1, int layer, LineStepper& line)
+{
+	const Layer& L = Layers[layer];
+	assert(L.format == LayerFormat::BGRA8);
+	if (!ClipLine(p0, p1, { 0,0,L.width,L.height }, line))
+	{
+		return false;
 	}
-	else if (p0.y == p1.y)
+	MarkDirty(iRect({ std::min(line.x, line.endX),std::min(line.y, line.endY) }, abs(line.endX - line.x) + 1, abs(line.endY - line.y) + 1), layer);
+	return true;
+}
+
+void Graphics::PlotLine(Layer& L, const LineStepper& line, const Color& color)
+{
+	const int majorStride = line.majorY * L.width + line.majorX;
+	const int minorStride = line.minorY * L.width + line.minorX;
+	Color* pPixel = &L.pixelMap[line.y * L.width + line.x];
+	long long error = line.error;
+	for (int i = 1;; ++i)
 	{
-		int deltaX = 1;
-		if (p1.x < p0.x)
+		*pPixel = color;
+		if (i == line.count)
 		{
-			deltaX = -1;
+			break;
 		}
-		for (int x = p0.x; x != p1.x; x += deltaX)
+		pPixel += majorStride;
+		error += line.errorStep;
+		if (error >= line.errorWrap)
 		{
-			if (gfxRect.ContainsPoint({ x,p0.y }))
-			{
-				SetPixel(x, p0.y, color, layer);
-			}
+			error -= line.errorWrap;
+			pPixel += minorStride;
 		}
 	}
-	else
+}
+
+void Graphics::DrawLine(vec2i p0, vec2i p1, const Color& color, int layer)
+{
+	LineStepper line;
+	if (!BeginLine(p0, p1, layer, line))
+	{
+		return;
+	}
+	PlotLine(Layers[layer], line, color);
+}
+
+void Graphics::GenerateEllipseSpans(int x, int y, int rx, int ry)
+{
+	const long long rxSQ = (long long)rx * rx;
+	const long long rySQ = (long long)ry * ry;
+	const long long limit = rxSQ * rySQ;
+	halfWidths.resize(ry + 1);
+	int h = rx;
+	for (int d = 0; d <= ry; ++d)
+	{
+		while (h > 0 && (long long)h * h * rySQ + (long long)d * d * rxSQ > limit)
+		{
+			--h;
+		}
+		halfWidths[d] = h;
+	}
+	const int cx = x + rx;
+	const int cy = y + ry;
+	spans.clear();
+	for (int ly = y; ly < y + 2 * ry; ++ly)
+	{
+		const int half = halfWidths[abs(ly - cy)];
+		spans.push_back({ ly,cx - half,std::min(cx + half, cx + rx - 1) });
+	}
+}
+
+void Graphics::GenerateRoundedRectSpans(const iRect& rect, int radius)
+{
+	const int left = rect.pos.x;
+	const int top = rect.pos.y;
+	const int right = left + rect.width - 1;
+	const int bottom = top + rect.height - 1;
+	radius = std::max(0, std::min(radius, std::min(rect.width, rect.height) / 2));
+	const long long rSQ = (long long)radius * radius;
+	halfWidths.resize(radius + 1);
+	int h = radius;
+	for (int d = 0; d <= radius; ++d)
 	{
-		int rise = p1.y - p0.y;
-		int run = p1.x - p0.x;
-		if (abs(run) >= abs(rise))
+		while (h > 0 && (long long)h * h + (long long)d * d > rSQ)
 		{
-			int deltaX = 1;
-			if (run < 0)
+			--h;
+		}
+		halfWidths[d] = h;
+	}
+	spans.clear();
+	for (int ly = top; ly <= bottom; ++ly)
+	{
+		const int d = std::max({ 0, top + radius - ly, ly - (bottom - radius) });
+		const int inset = radius - halfWidths[d];
+		spans.push_back({ ly,left + inset,right - inset });
+	}
+}
+
+void Graphics::GeneratePolygonSpans(const std::vector<vec2i>& points, int layer)
+{
+	const Layer& L = Layers[layer];
+	spans.clear();
+	if (points.size() < 3)
+	{
+		return;
+	}
+	int minY = points[0].y;
+	int maxY = points[0].y;
+	for (const vec2i& p : points)
+	{
+		minY = std::min(minY, p.y);
+		maxY = std::max(maxY, p.y);
+	}
+	minY = std::max(minY, 0);
+	maxY = std::min(maxY, L.height);
+	const size_t nPoints = points.size();
+	for (int ly = minY; ly < maxY; ++ly)
+	{
+		const float scanY = (float)ly + 0.5f;
+		crossings.clear();
+		for (size_t i = 0; i < nPoints; ++i)
+		{
+			const vec2i& a = points[i];
+			const vec2i& b = points[(i + 1) % nPoints];
+			if ((a.y <= scanY) != (b.y <= scanY))
 			{
-				deltaX = -1;
+				crossings.push_back((float)a.x + (scanY - (float)a.y) * (float)(b.x - a.x) / (float)(b.y - a.y));
 			}
-			float m = (float)rise / (float)run;
-			for (int x = p0.x; x != p1.x; x += deltaX)
+		}
+		std::sort(crossings.begin(), crossings.end());
+		for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+		{
+			const int spanLeft = (int)ceil(crossings[i] - 0.5f);
+			const int spanRight = (int)ceil(crossings[i + 1] - 0.5f) - 1;
+			if (spanLeft <= spanRight)
 			{
-				int y = int(m * float(x - p0.x)) + p0.y;
-				if (gfxRect.ContainsPoint({ x,y }))
-				{
-					SetPixel(x, y, color, layer);
-				}
+				spans.push_back({ ly,spanLeft,spanRight });
 			}
 		}
+	}
+}
+
+void Graphics::OutlineSpans()
+{
+	outlineSpans.clear();
+	const int nSpans = (int)spans.size();
+	for (int i = 0; i < nSpans; ++i)
+	{
+		const Span& span = spans[i];
+		int innerLeft = span.left + 1;
+		int innerRight = span.right - 1;
+		if (i == 0 || i == nSpans - 1)
+		{
+			innerLeft = span.right + 1;
+		}
 		else
 		{
-			int deltaY = 1;
-			if (rise < 0)
-			{
-				deltaY = -1;
-			}
-			float m_inv = (float)run / (float)rise;
-			for (int y = p0.y; y != p1.y; y += deltaY)
-			{
-				int x = int(m_inv * float(y - p0.y)) + p0.x;
-				if (gfxRect.ContainsPoint({ x,y }))
-				{
-					SetPixel(x, y, color, layer);
-				}
-			}
+			const Span& above = spans[i - 1];
+			const Span& below = spans[i + 1];
+			innerLeft = std::max({ innerLeft, above.left, below.left });
+			innerRight = std::min({ innerRight, above.right, below.right });
+		}
+		if (innerLeft > innerRight)
+		{
+			outlineSpans.push_back(span);
+		}
+		else
+		{
+			outlineSpans.push_back({ span.y,span.left,innerLeft - 1 });
+			outlineSpans.push_back({ span.y,innerRight + 1,span.right });
 		}
 	}
+	spans.swap(outlineSpans);
 }
 
-void Graphics::DrawLine(vec2i p0, vec2i p1, std::function<Color(int, int)> color_func, int layer)
+void Graphics::ClipSpans(int layer)
 {
-	assert(p0 != p1);
-	const iRect gfxRect = GetRect(layer);
-	if (p0.x == p1.x)
+	const Layer& L = Layers[layer];
+	assert(L.format == LayerFormat::BGRA8);
+	int left = L.width;
+	int top = L.height;
+	int right = -1;
+	int bottom = -1;
+	size_t nKept = 0;
+	for (const Span& span : spans)
 	{
-		int deltaY = 1;
-		if (p1.y < p0.y)
+		const Span clipped = { span.y,std::max(span.left, 0),std::min(span.right, L.width - 1) };
+		if (clipped.y >= 0 && clipped.y < L.height && clipped.left <= clipped.right)
 		{
-			deltaY = -1;
+			spans[nKept++] = clipped;
+			left = std::min(left, clipped.left);
+			right = std::max(right, clipped.right);
+			top = std::min(top, clipped.y);
+			bottom = std::max(bottom, clipped.y);
 		}
-		for (int y = p0.y; y != p1.y; y += deltaY)
+	}
+	spans.resize(nKept);
+	if (nKept)
+	{
+		MarkDirty(iRect({ left,top }, right - left + 1, bottom - top + 1), layer);
+	}
+}
+
+void Graphics::FillSpans(const Color& color, int layer)
+{
+	ClipSpans(layer);
+	Layer& L = Layers[layer];
+	for (const Span& span : spans)
+	{
+		Color* const pRow = &L.pixelMap[span.y * L.width];
+		std::fill(pRow + span.left, pRow + span.right + 1, color);
+	}
+}
+
+void Graphics::DrawCircle(int x, int y, int r, const Color& color, int layer)
+{
+	assert(r > 0);
+	GenerateEllipseSpans(x, y, r, r);
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawCircleOutline(int x, int y, int r, const Color& color, int layer)
+{
+	assert(r > 0);
+	GenerateEllipseSpans(x, y, r, r);
+	OutlineSpans();
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawEllipse(int x, int y, int rx, int ry, const Color& color, int layer)
+{
+	assert(rx > 0 && ry > 0);
+	GenerateEllipseSpans(x, y, rx, ry);
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawEllipseOutline(int x, int y, int rx, int ry, const Color& color, int layer)
+{
+	assert(rx > 0 && ry > 0);
+	GenerateEllipseSpans(x, y, rx, ry);
+	OutlineSpans();
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawRoundedRect(const iRect& rect, int radius, const Color& color, int layer)
+{
+	GenerateRoundedRectSpans(rect, radius);
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawRoundedRectOutline(const iRect& rect, int radius, const Color& color, int layer)
+{
+	GenerateRoundedRectSpans(rect, radius);
+	OutlineSpans();
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawPolygon(const std::vector<vec2i>& points, const Color& color, int layer)
+{
+	GeneratePolygonSpans(points, layer);
+	FillSpans(color, layer);
+}
+
+void Graphics::DrawPolygonOutline(const std::vector<vec2i>& points, const Color& color, int layer)
+{
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		DrawLine(points[i], points[(i + 1) % points.size()], color, layer);
+	}
+}
+
+void Graphics::QueueCommand(DrawCommand command, const DirtyRect& area, const Image* pImage)
+{
+	assert(command.layer >= 0 && command.layer < (int)Layers.size());
+	const Layer& L = Layers[command.layer];
+	assert(L.format == LayerFormat::BGRA8);
+	command.bounds = { std::max(area.left, 0),std::max(area.top, 0),std::min(area.right, L.width),std::min(area.bottom, L.height) };
+	if (command.bounds.left >= command.bounds.right || command.bounds.top >= command.bounds.bottom)
+	{
+		return;
+	}
+	command.sequence = (int)commands.size();
+	if (pImage)
+	{
+		commandSources.push_back(pImage->SharePixels());
+	}
+	MarkDirty(iRect({ command.bounds.left,command.bounds.top }, command.bounds.right - command.bounds.left, command.bounds.bottom - command.bounds.top), command.layer);
+	commands.push_back(command);
+}
+
+Graphics::DrawCommand Graphics::MakeImageCommand(CommandType type, const Image& image, int x, int y, int width, int height, int depth, int layer)
+{
+	assert(width > 0 && height > 0);
+	DrawCommand command = {};
+	command.type = type;
+	command.mode = BlendMode::SourceOver;
+	command.opacity = 255;
+	command.layer = layer;
+	command.depth = depth;
+	command.pSource = image.GetPtrToImage();
+	command.sourceWidth = image.GetWidth();
+	command.sourceHeight = image.GetHeight();
+	command.x0 = x;
+	command.y0 = y;
+	command.x1 = x + width;
+	command.y1 = y + height;
+	return command;
+}
+
+void Graphics::ExecuteCommand(const DrawCommand& command, const DirtyRect& clip)
+{
+	Layer& L = Layers[command.layer];
+	const int nCols = clip.right - clip.left;
+	switch (command.type)
+	{
+	case CommandType::FillRect:
+	{
+		for (int y = clip.top; y < clip.bottom; ++y)
 		{
-			if (gfxRect.ContainsPoint({ p0.x,y }))
-			{
-				SetPixel(p0.x, y, color_func(p0.x, y), layer);
-			}
+			std::fill_n(&L.pixelMap[y * L.width + clip.left], nCols, command.color);
 		}
+		break;
 	}
-	else if (p0.y == p1.y)
+	case CommandType::Line:
 	{
-		int deltaX = 1;
-		if (p1.x < p0.x)
+		LineStepper line;
+		if (ClipLine({ command.x0,command.y0 }, { command.x1,command.y1 }, clip, line))
 		{
-			deltaX = -1;
+			PlotLine(L, line, command.color);
 		}
-		for (int x = p0.x; x != p1.x; x += deltaX)
+		break;
+	}
+	case CommandType::Ellipse:
+	{
+		const int rx = (command.x1 - command.x0) / 2;
+		const int ry = (command.y1 - command.y0) / 2;
+		const long long rxSQ = (long long)rx * rx;
+		const long long rySQ = (long long)ry * ry;
+		const long long limit = rxSQ * rySQ;
+		const int cx = command.x0 + rx;
+		const int cy = command.y0 + ry;
+		for (int y = clip.top; y < clip.bottom; ++y)
 		{
-			if (gfxRect.ContainsPoint({ x,p0.y }))
+			const long long d = abs(y - cy);
+			const long long remainder = limit - d * d * rxSQ;
+			int half = (int)sqrt((double)remainder / (double)rySQ);
+			while ((long long)half * half * rySQ > remainder)
+			{
+				--half;
+			}
+			while ((long long)(half + 1) * (half + 1) * rySQ <= remainder)
+			{
+				++half;
+			}
+			const int left = std::max(cx - half, clip.left);
+			const int right = std::min(std::min(cx + half, cx + rx - 1) + 1, clip.right);
+			if (left < right)
 			{
-				SetPixel(x, p0.y, color_func(x, p0.y), layer);
+				std::fill(&L.pixelMap[y * L.width + left], &L.pixelMap[y * L.width + right], command.color);
 			}
 		}
+		break;
 	}
-	else
+	default:
 	{
-		int rise = p1.y - p0.y;
-		int run = p1.x - p0.x;
-		if (abs(run) >= abs(rise))
+		const bool unscaledX = (command.x1 - command.x0 == command.sourceWidth);
+		thread_local std::vector<int> srcCols;
+		thread_local std::vector<Color> srcRowBuffer;
+		if (!unscaledX)
+		{
+			srcCols.resize(nCols);
+			srcRowBuffer.resize(nCols);
+			PixelKernels::NearestIndices(srcCols.data(), clip.left - command.x0, nCols, command.x1 - command.x0, command.sourceWidth);
+		}
+		for (int y = clip.top; y < clip.bottom; ++y)
 		{
-			int deltaX = 1;
-			if (run < 0)
+			Color* const pDstRow = &L.pixelMap[y * L.width + clip.left];
+			const Color* pSrcRow = &command.pSource[PixelKernels::NearestIndex(y - command.y0, command.y1 - command.y0, command.sourceHeight) * command.sourceWidth];
+			if (unscaledX)
 			{
-				deltaX = -1;
+				pSrcRow += clip.left - command.x0;
 			}
-			float m = (float)rise / (float)run;
-			for (int x = p0.x; x != p1.x; x += deltaX)
+			else if (command.type == CommandType::Blit)
 			{
-				int y = int(m * float(x - p0.x)) + p0.y;
-				if (gfxRect.ContainsPoint({ x,y }))
-				{
-					SetPixel(x, y, color_func(x, y), layer);
-				}
+				PixelKernels::GatherRow(pDstRow, pSrcRow, srcCols.data(), nCols);
+				continue;
 			}
-		}
-		else
-		{
-			int deltaY = 1;
-			if (rise < 0)
+			else
 			{
-				deltaY = -1;
+				PixelKernels::GatherRow(srcRowBuffer.data(), pSrcRow, srcCols.data(), nCols);
+				pSrcRow = srcRowBuffer.data();
 			}
-			float m_inv = (float)run / (float)rise;
-			for (int y = p0.y; y != p1.y; y += deltaY)
+			switch (command.type)
 			{
-				int x = int(m_inv * float(y - p0.y)) + p0.x;
-				if (gfxRect.ContainsPoint({ x,y }))
-				{
-					SetPixel(x, y, color_func(x, y), layer);
-				}
+			case CommandType::Blit:
+				PixelKernels::CopyRow(pDstRow, pSrcRow, nCols);
+				break;
+			case CommandType::BlitWithTransparency:
+				PixelKernels::CopyRowWithTransparency(pDstRow, pSrcRow, nCols);
+				break;
+			default:
+				PixelKernels::BlendRow(pDstRow, pSrcRow, nCols, command.mode, command.opacity);
+				break;
 			}
 		}
+		break;
+	}
 	}
 }
 
-void Graphics::DrawCircle(int x, int y, int r, const Color& color, int layer)
+void Graphics::QueueImage(const Image& image, int x, int y, int depth, int layer)
 {
-	assert(r > 0);
-	const int d = r * 2;
-	assert(x + d >= 0 && y + d >= 0);
-	const iRect gfxRect = GetRect(layer);
-	vec2i center{ x + r,y + r };
-	int rSQ = sq(r);
-	for (int ly = y; ly < y + d; ++ly)
+	QueueImage(image, image.GetRect(x, y), depth, layer);
+}
+
+void Graphics::QueueImage(const Image& image, const iRect& dest, int depth, int layer)
+{
+	const DrawCommand command = MakeImageCommand(CommandType::Blit, image, dest.pos.x, dest.pos.y, dest.width, dest.height, depth, layer);
+	QueueCommand(command, { command.x0,command.y0,command.x1,command.y1 }, &image);
+}
+
+void Graphics::QueueImageWithTransparency(const Image& image, int x, int y, int depth, int layer)
+{
+	QueueImageWithTransparency(image, image.GetRect(x, y), depth, layer);
+}
+
+void Graphics::QueueImageWithTransparency(const Image& image, const iRect& dest, int depth, int layer)
+{
+	const DrawCommand command = MakeImageCommand(CommandType::BlitWithTransparency, image, dest.pos.x, dest.pos.y, dest.width, dest.height, depth, layer);
+	QueueCommand(command, { command.x0,command.y0,command.x1,command.y1 }, &image);
+}
+
+void Graphics::QueueImageBlended(const Image& image, int x, int y, BlendMode mode, float opacity, int depth, int layer)
+{
+	assert(opacity >= 0.0f && opacity <= 1.0f);
+	DrawCommand command = MakeImageCommand(CommandType::Blend, image, x, y, image.GetWidth(), image.GetHeight(), depth, layer);
+	command.mode = mode;
+	command.opacity = (unsigned char)(opacity * 255.0f + 0.5f);
+	QueueCommand(command, { x,y,command.x1,command.y1 }, &image);
+}
+
+void Graphics::QueueRect(const iRect& rect, const Color& color, int depth, int layer)
+{
+	DrawCommand command = {};
+	command.type = CommandType::FillRect;
+	command.color = color;
+	command.layer = layer;
+	command.depth = depth;
+	command.x0 = rect.pos.x;
+	command.y0 = rect.pos.y;
+	command.x1 = rect.pos.x + rect.width;
+	command.y1 = rect.pos.y + rect.height;
+	QueueCommand(command, { command.x0,command.y0,command.x1,command.y1 });
+}
+
+void Graphics::QueueLine(vec2i p0, vec2i p1, const Color& color, int depth, int layer)
+{
+	DrawCommand command = {};
+	command.type = CommandType::Line;
+	command.color = color;
+	command.layer = layer;
+	command.depth = depth;
+	command.x0 = p0.x;
+	command.y0 = p0.y;
+	command.x1 = p1.x;
+	command.y1 = p1.y;
+	QueueCommand(command, { std::min(p0.x, p1.x),std::min(p0.y, p1.y),std::max(p0.x, p1.x) + 1,std::max(p0.y, p1.y) + 1 });
+}
+
+void Graphics::QueueCircle(int x, int y, int r, const Color& color, int depth, int layer)
+{
+	QueueEllipse(x, y, r, r, color, depth, layer);
+}
+
+void Graphics::QueueEllipse(int x, int y, int rx, int ry, const Color& color, int depth, int layer)
+{
+	assert(rx > 0 && ry > 0);
+	DrawCommand command = {};
+	command.type = CommandType::Ellipse;
+	command.color = color;
+	command.layer = layer;
+	command.depth = depth;
+	command.x0 = x;
+	command.y0 = y;
+	command.x1 = x + 2 * rx;
+	command.y1 = y + 2 * ry;
+	QueueCommand(command, { command.x0,command.y0,command.x1,command.y1 });
+}
+
+void Graphics::FlushCommands()
+{
+	if (commands.empty())
+	{
+		return;
+	}
+	std::sort(commands.begin(), commands.end(), [](const DrawCommand& a, const DrawCommand& b)
+	{
+		if (a.layer != b.layer)
+		{
+			return a.layer < b.layer;
+		}
+		if (a.depth != b.depth)
+		{
+			return a.depth < b.depth;
+		}
+		return a.sequence < b.sequence;
+	});
+	// grouping by source is only invisible among commands that share no pixels, so it stays within such runs
+	for (size_t first = 0; first < commands.size();)
 	{
-		for (int lx = x; lx < x + d; ++lx)
+		size_t last = first + 1;
+		while (last < commands.size() && last - first < maxSourceRun &&
+			commands[last].layer == commands[first].layer && commands[last].depth == commands[first].depth &&
+			std::none_of(commands.begin() + first, commands.begin() + last, [&](const DrawCommand& c)
+			{
+				const DirtyRect& b = commands[last].bounds;
+				return c.bounds.left < b.right && b.left < c.bounds.right && c.bounds.top < b.bottom && b.top < c.bounds.bottom;
+			}))
+		{
+			++last;
+		}
+		std::sort(commands.begin() + first, commands.begin() + last, [](const DrawCommand& a, const DrawCommand& b)
 		{
-			const vec2i point{ lx,ly };
-			if ((point - center).LengthSq() <= rSQ && gfxRect.ContainsPoint(point))
+			if (a.pSource != b.pSource)
 			{
-				SetPixel(lx, ly, color, layer);
+				return std::less<const Color*>()(a.pSource, b.pSource);
 			}
+			return a.sequence < b.sequence;
+		});
+		first = last;
+	}
+	// an Erase issued after queueing has already flagged the layer as cleared, but the replay lands after it
+	int lastLayer = -1;
+	for (const DrawCommand& command : commands)
+	{
+		if (command.layer != lastLayer)
+		{
+			Layers[command.layer].Modified();
+			lastLayer = command.layer;
 		}
 	}
-}
-
-void Graphics::DrawCircle(int x, int y, int r, std::function<Color(int, int)> color_func, int layer)
-{
-	assert(r > 0);
-	const int d = r * 2;
-	assert(x + d >= 0 && y + d >= 0);
-	const iRect gfxRect = GetRect(layer);
-	vec2i center{ x + r,y + r };
-	int rSQ = sq(r);
-	for (int ly = y; ly < y + d; ++ly)
+	if (!isParallelReplayEnabled || WorkerPool::Shared().GetThreadCount() == 1)
+	{
+		for (const DrawCommand& command : commands)
+		{
+			ExecuteCommand(command, command.bounds);
+		}
+	}
+	else
 	{
-		for (int lx = x; lx < x + d; ++lx)
+		// bands never share pixels, so each one replays its slice of the sorted list independently
+		std::vector<int> firstBand(Layers.size() + 1, 0);
+		for (size_t i = 0; i < Layers.size(); ++i)
+		{
+			firstBand[i + 1] = firstBand[i] + (Layers[i].height + commandBandHeight - 1) / commandBandHeight;
+		}
+		commandBands.resize(firstBand.back());
+		activeBands.clear();
+		for (int i = 0; i < (int)commands.size(); ++i)
 		{
-			const vec2i point{ lx,ly };
-			if ((point - center).LengthSq() <= rSQ && gfxRect.ContainsPoint(point))
+			const DrawCommand& command = commands[i];
+			const int lastBand = firstBand[command.layer] + (command.bounds.bottom - 1) / commandBandHeight;
+			for (int band = firstBand[command.layer] + command.bounds.top / commandBandHeight; band <= lastBand; ++band)
 			{
-				SetPixel(lx, ly, color_func(lx, ly), layer);
+				if (commandBands[band].empty())
+				{
+					activeBands.push_back(band);
+				}
+				commandBands[band].push_back(i);
 			}
 		}
+		WorkerPool::Shared().ParallelFor((int)activeBands.size(), [&](int i)
+		{
+			std::vector<int>& bin = commandBands[activeBands[i]];
+			for (const int index : bin)
+			{
+				const DrawCommand& command = commands[index];
+				const int bandTop = (activeBands[i] - firstBand[command.layer]) * commandBandHeight;
+				ExecuteCommand(command, { command.bounds.left,std::max(command.bounds.top, bandTop),command.bounds.right,std::min(command.bounds.bottom, bandTop + commandBandHeight) });
+			}
+			bin.clear();
+		});
 	}
+	commands.clear();
+	commandSources.clear();
+}
+
+int Graphics::GetQueuedCommandCount() const
+{
+	return (int)commands.size();
+}
+
+const bool& Graphics::isReplayingInParallel() const
+{
+	return isParallelReplayEnabled;
+}
+
+void Graphics::EnableParallelReplay()
+{
+	isParallelReplayEnabled = true;
+}
+
+void Graphics::DisableParallelReplay()
+{
+	isParallelReplayEnabled = false;
 }
 
 void Graphics::SetFullscreen()
 {
-	GFXCHECK(pFrameManager->SetFullscreenState(true, nullptr));
+	RunOnBackend([](GraphicsBackend& backend)
+	{
+		backend.SetFullscreen(true);
+	});
 }
 
 void Graphics::ExitFullscreen()
 {
-	GFXCHECK(pFrameManager->SetFullscreenState(false, nullptr));
+	RunOnBackend([](GraphicsBackend& backend)
+	{
+		backend.SetFullscreen(false);
+	});
 }
 
 bool Graphics::isFullscreen()
 {
-	BOOL isFullscreen;
-	GFXCHECK(pFrameManager->GetFullscreenState(&isFullscreen, nullptr));
-	return isFullscreen;
+	return SyncBackend().isFullscreen();
 }
 
 const int& Graphics::GetWidth(int layer) const
@@ -563,7 +1484,7 @@ vec2i Graphics::GetDimensions(int layer) const
 
 vec2i Graphics::GetViewDimensions(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return vec2i((int)vp.Width, (int)vp.Height);
 }
 
@@ -575,7 +1496,7 @@ iRect Graphics::GetRect(int layer) const
 
 iRect Graphics::GetViewRect(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return iRect({ (int)vp.TopLeftX,(int)vp.TopLeftY }, (int)vp.Width, (int)vp.Height);
 }
 
@@ -607,7 +1528,7 @@ vec2 Graphics::GetDimensions_FLOAT(int layer) const
 
 vec2 Graphics::GetViewDimensions_FLOAT(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return vec2(vp.Width, vp.Height);
 }
 
@@ -619,7 +1540,7 @@ fRect Graphics::GetRect_FLOAT(int layer) const
 
 fRect Graphics::GetViewRect_FLOAT(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return fRect({ vp.TopLeftX,vp.TopLeftY }, vp.Width, vp.Height);
 }
 
@@ -631,7 +1552,7 @@ float Graphics::GetAspectRatio(int layer) const
 
 float Graphics::GetViewAspectRatio(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return vp.Width / vp.Height;
 }
 
@@ -643,7 +1564,7 @@ float Graphics::GetInvAspectRatio(int layer) const
 
 float Graphics::GetInvViewAspectRatio(int layer) const
 {
-	const D3D11_VIEWPORT& vp = Layers[layer].viewport;
+	const Viewport& vp = Layers[layer].viewport;
 	return vp.Height / vp.Width;
 }
 
@@ -659,14 +1580,43 @@ const int& Graphics::GetSizeInBytes(int layer) const
 
 const std::vector<Color>& Graphics::GetPixelMap(int layer) const
 {
+	assert(Layers[layer].format == LayerFormat::BGRA8);
 	return Layers[layer].pixelMap;
 }
 
 std::vector<Color>& Graphics::GetPixelMap(int layer)
 {
+	assert(Layers[layer].format == LayerFormat::BGRA8);
+	Layers[layer].Modified();
 	return Layers[layer].pixelMap;
 }
 
+const std::vector<unsigned char>& Graphics::GetIndexMap(int layer) const
+{
+	assert(Layers[layer].format == LayerFormat::Indexed8);
+	return Layers[layer].indexMap;
+}
+
+std::vector<unsigned char>& Graphics::GetIndexMap(int layer)
+{
+	assert(Layers[layer].format == LayerFormat::Indexed8);
+	Layers[layer].Modified();
+	return Layers[layer].indexMap;
+}
+
+const std::vector<unsigned short>& Graphics::GetPackedMap(int layer) const
+{
+	assert(Layers[layer].format == LayerFormat::RGB565);
+	return Layers[layer].packedMap;
+}
+
+std::vector<unsigned short>& Graphics::GetPackedMap(int layer)
+{
+	assert(Layers[layer].format == LayerFormat::RGB565);
+	Layers[layer].Modified();
+	return Layers[layer].packedMap;
+}
+
 void Graphics::SetViewport(int x, int y, int width, int height, int layer)
 {
 	Layers[layer].viewport.TopLeftX = (float)x;
@@ -732,6 +1682,18 @@ const vec2& Graphics::GetScale(int layer) const
 	return Layers[layer].scale;
 }
 
+void Graphics::SetWrapOrigin(vec2i origin, int layer)
+{
+	Layer& L = Layers[layer];
+	L.wrapOrigin.x = ((origin.x % L.width) + L.width) % L.width;
+	L.wrapOrigin.y = ((origin.y % L.height) + L.height) % L.height;
+}
+
+const vec2i& Graphics::GetWrapOrigin(int layer) const
+{
+	return Layers[layer].wrapOrigin;
+}
+
 mat4 Graphics::GetTransformationMatrix(int layer) const
 {
 	return
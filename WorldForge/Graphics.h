@@ -1,19 +1,26 @@
 #pragma once
-#include <d3d11.h>
-#include <wrl.h>
+#ifdef _WIN32
 #include "Win32Includes.h"
+#endif
 #include "BaseException.h"
+#include "GraphicsBackend.h"
+#include "SubmissionThread.h"
 #include "Shaders.h"
 #include "Color.h"
 #include <optional>
 #include <vector>
+#include <memory>
+#include <string>
 #include <functional>
+#include <type_traits>
+#include <assert.h>
 
 template <typename type>
 class Rect;
 using fRect = Rect<float>;
 using iRect = Rect<int>;
 using uRect = Rect<int>;
+class Image;
 
 class Graphics
 {
@@ -21,6 +28,7 @@ class Graphics
 public:
 	class Exception : public BaseException
 	{
+#ifdef _WIN32
 	private:
 		std::optional<HRESULT> hr;
 	private:
@@ -60,6 +68,23 @@ public:
 			BaseException(line, file, note),
 			hr(hr)
 		{}
+#else
+	private:
+		std::string GetErrorCodeString() const noexcept
+		{
+			return "N/A";
+		}
+		std::string GetDescriptionString() const noexcept
+		{
+			return "N/A";
+		}
+	public:
+		Exception() = delete;
+		Exception(int line, std::string file, std::string note) noexcept
+			:
+			BaseException(line, file, note)
+		{}
+#endif
 		const char* what() const noexcept override
 		{
 			std::ostringstream wht;
@@ -74,43 +99,151 @@ public:
 		}
 		const char* GetType() const noexcept override
 		{
-			return "FantasyForge Direct3D 11 Exception";
+			return "FantasyForge Graphics Exception";
 		}
 	};
 	#define GFXEXCPT(hr_or_note) Graphics::Exception(__LINE__, __FILE__, hr_or_note)
 	#define GFXEXCPT_NOTE(hr, note) Graphics::Exception(__LINE__, __FILE__, hr, note)
 	#define GFXCHECK(hr) if (FAILED(hr)) { throw GFXEXCPT(hr); }
+public:
+	struct FrameStats
+	{
+		long long bytesCleared = 0;
+		long long bytesUploaded = 0;
+		int layersUploaded = 0;
+		int layersSkipped = 0;
+	};
+	enum class LayerFormat : unsigned char
+	{
+		BGRA8,
+		Indexed8,
+		RGB565
+	};
 private:
+	using DirtyRect = GraphicsBackend::DirtyRect;
+	using Viewport = GraphicsBackend::Viewport;
+	struct ClearTile
+	{
+		char* pFirstRow;
+		int rowBytes;
+		int pitch;
+		int nRows;
+	};
+	static constexpr int clearTileBytes = 64 * 1024;
+	struct Span
+	{
+		int y;
+		int left;
+		int right;
+	};
+	struct LineStepper
+	{
+		int x;
+		int y;
+		int count;
+		int majorX;
+		int majorY;
+		int minorX;
+		int minorY;
+		long long error;
+		long long errorStep;
+		long long errorWrap;
+		int endX;
+		int endY;
+		void Advance()
+		{
+			x += majorX;
+			y += majorY;
+			error += errorStep;
+			if (error >= errorWrap)
+			{
+				error -= errorWrap;
+				x += minorX;
+				y += minorY;
+			}
+		}
+	};
+	enum class CommandType : unsigned char
+	{
+		Blit,
+		BlitWithTransparency,
+		Blend,
+		FillRect,
+		Line,
+		Ellipse
+	};
+	// lines use (x0,y0)-(x1,y1) as endpoints, everything else as its destination rect with x1/y1 exclusive
+	struct DrawCommand
+	{
+		CommandType type;
+		BlendMode mode;
+		unsigned char opacity;
+		Color color;
+		int layer;
+		int depth;
+		int sequence;
+		const Color* pSource;
+		int sourceWidth;
+		int sourceHeight;
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		DirtyRect bounds;
+	};
+	static constexpr int commandBandHeight = 64;
+	static constexpr int maxSourceRun = 64;
+	static constexpr int stagingRingSize = 2;
+	struct LayerSubmission
+	{
+		int layer;
+		const Color* pPixels;
+		int pitch;
+		bool isFullUpload;
+		std::vector<DirtyRect> regions;
+		GraphicsBackend::LayerTransform transform;
+	};
 	struct Layer
 	{
 		friend class Graphics;
 	private:
 		bool isAutoManaged;
 		bool renderFlag;
+		bool isDirtyTracked;
+		bool isCleared;
+		LayerFormat format;
+		unsigned long long contentVersion;
+		unsigned long long uploadedVersion;
 		const int width;
 		const int height;
 		const int nPixels;
-		const int nImageBytes;
-		const int nImagePitchBytes;
+		int nImageBytes;
+		int nImagePitchBytes;
 		std::vector<Color> pixelMap;
-		D3D11_VIEWPORT viewport;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader> pPShader;
-		Microsoft::WRL::ComPtr<ID3D11VertexShader> pVShader;
-		Microsoft::WRL::ComPtr<ID3D11Texture2D> pPixelMap;
-		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> pPixelMapView;
-		Microsoft::WRL::ComPtr<ID3D11SamplerState> pSampler;
-		Microsoft::WRL::ComPtr<ID3D11Buffer> pPSCBUF;
-		Microsoft::WRL::ComPtr<ID3D11Buffer> pVSCBUF;
+		std::vector<unsigned char> indexMap;
+		std::vector<unsigned short> packedMap;
+		std::vector<Color> palette;
+		mutable std::vector<DirtyRect> dirtyRects;
+		mutable std::vector<DirtyRect> clearRects;
+		std::vector<DirtyRect> uploadRects;
+		std::vector<Color> staging[stagingRingSize];
+		Viewport viewport;
 	private:
 		vec2 position;
 		float rotation;
 		vec2 scale;
+		vec2i wrapOrigin;
 	public:
 		Layer() = delete;
 		Layer(int width, int height)
 			:
 			isAutoManaged(true),
 			renderFlag(true),
+			isDirtyTracked(false),
+			isCleared(true),
+			format(LayerFormat::BGRA8),
+			contentVersion(1),
+			uploadedVersion(0),
 			width(width),
 			height(height),
 			nPixels(width* height),
@@ -119,29 +252,99 @@ private:
 			position(0.0f, 0.0f),
 			rotation(0.0f),
 			scale(1.0f, 1.0f),
+			wrapOrigin(0, 0),
 			pixelMap(),
 			viewport()
 		{
 			pixelMap.resize(nPixels, Colors::Transparent);
 		}
+		void Modified()
+		{
+			++contentVersion;
+			isCleared = false;
+		}
+		char* GetPixelPtr(int x, int y)
+		{
+			const size_t pxl = (size_t)y * width + x;
+			switch (format)
+			{
+			case LayerFormat::Indexed8:
+				return reinterpret_cast<char*>(&indexMap[pxl]);
+			case LayerFormat::RGB565:
+				return reinterpret_cast<char*>(&packedMap[pxl]);
+			default:
+				return reinterpret_cast<char*>(&pixelMap[pxl]);
+			}
+		}
 	};
 private:
-	Microsoft::WRL::ComPtr<ID3D11Device> pDevice = nullptr;
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> pPipeline = nullptr;
-	Microsoft::WRL::ComPtr<IDXGISwapChain> pFrameManager = nullptr;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> pFrameBufferView = nullptr;
-	mutable D3D11_MAPPED_SUBRESOURCE msr = {};
+	std::unique_ptr<GraphicsBackend> pBackend;
 	std::vector<Layer> Layers;
+	std::vector<ClearTile> clearTiles;
+	std::vector<Span> spans;
+	std::vector<Span> outlineSpans;
+	std::vector<int> halfWidths;
+	std::vector<float> crossings;
 	float4 fBackgroundColorRGBA = { 0.0f,0.0f,0.0f,1.0f };
+	std::vector<DrawCommand> commands;
+	// owners of the queued images' pixels, released once the commands are replayed
+	std::vector<std::shared_ptr<const Color[]>> commandSources;
+	std::vector<std::vector<int>> commandBands;
+	std::vector<int> activeBands;
+	bool isParallelReplayEnabled = true;
+	mutable FrameStats frameStats;
+	std::string frameDumpPrefix;
+	mutable int frameDumpIndex = 0;
+	unsigned long long nFramesEnded = 0;
+	unsigned long long stagingFences[stagingRingSize] = {};
+	unsigned long long lastFrameFence = 0;
+	std::unique_ptr<SubmissionThread> pSubmitter;
 private:
 	void UpdateViewportsAndFrameManager(float win_x_scale, float win_y_scale);
+	void CreateLayerTexture(int layer);
+	void RunOnBackend(std::function<void(GraphicsBackend&)> job) const;
+	GraphicsBackend& SyncBackend() const;
+	void CreateConstantBuffer(GraphicsBackend::ShaderStage stage, const void* pData, int size, int layer);
+	void UpdateConstantBuffer(GraphicsBackend::ShaderStage stage, const void* pData, int size, int layer) const;
+	const Color* StageLayer(Layer& L, int slot);
+	static void ExpandLayer(const Layer& L, Color* pDst, const DirtyRect& region);
+	static void SubmitFrame(GraphicsBackend& backend, const std::vector<LayerSubmission>& submissions, const std::string& dump_filename);
+	static Image ReadFrameImage(GraphicsBackend& backend);
+	static void AddDirtyRect(std::vector<DirtyRect>& rects, const DirtyRect& rect);
+	static bool ClipLine(vec2i p0, vec2i p1, const DirtyRect& clip, LineStepper& line);
+	bool BeginLine(vec2i p0, vec2i p1, int layer, LineStepper& line);
+	static void PlotLine(Layer& L, const LineStepper& line, const Color& color);
+	void GenerateEllipseSpans(int x, int y, int rx, int ry);
+	void GenerateRoundedRectSpans(const iRect& rect, int radius);
+	void GeneratePolygonSpans(const std::vector<vec2i>& points, int layer);
+	void OutlineSpans();
+	void ClipSpans(int layer);
+	void FillSpans(const Color& color, int layer);
+	void QueueCommand(DrawCommand command, const DirtyRect& area, const Image* pImage = nullptr);
+	static DrawCommand MakeImageCommand(CommandType type, const Image& image, int x, int y, int width, int height, int depth, int layer);
+	void ExecuteCommand(const DrawCommand& command, const DirtyRect& clip);
 public:
 	Graphics() = delete;
 	Graphics(const Graphics& gfx) = delete;
 	Graphics operator =(const Graphics& gfx) = delete;
+#ifdef _WIN32
 	Graphics(HWND hWnd, int WindowWidth, int WindowHeight, std::vector<int2> display_layer_dims);
+#endif
+	Graphics(int FrameWidth, int FrameHeight, std::vector<int2> display_layer_dims);
+	Graphics(std::unique_ptr<GraphicsBackend> backend, int FrameWidth, int FrameHeight, std::vector<int2> display_layer_dims);
+	~Graphics();
 	void NewFrame();
-	void EndFrame() const;
+	void EndFrame();
+	Image CaptureFrame() const;
+	void EnableFrameDump(const std::string& filename_prefix);
+	void DisableFrameDump();
+	GraphicsBackend& GetBackend();
+	void EnableAsyncSubmission();
+	void DisableAsyncSubmission();
+	bool isSubmittingAsync() const;
+	unsigned long long GetFrameFence() const;
+	bool isFrameComplete(unsigned long long fence) const;
+	void WaitForFrame(unsigned long long fence) const;
 	const bool& isAutoManaged(int layer = 0) const;
 	void AutoManage(int layer = 0);
 	void ManuallyManage(int layer = 0);
@@ -149,6 +352,17 @@ public:
 	const bool& isBeingRendered(int layer = 0) const;
 	void StartRendering(int layer = 0);
 	void StopRendering(int layer = 0);
+	const bool& isDirtyTracked(int layer = 0) const;
+	void EnableDirtyTracking(int layer = 0);
+	void DisableDirtyTracking(int layer = 0);
+	void MarkDirty(const iRect& region, int layer = 0);
+	// compact layers are expanded to BGRA on upload and can't be drawn to through the Color routines;
+	// they clear to index 0 (Indexed8) or opaque black (RGB565, which has no alpha)
+	void SetLayerFormat(LayerFormat format, int layer = 0);
+	const LayerFormat& GetLayerFormat(int layer = 0) const;
+	void SetLayerPalette(const std::vector<Color>& palette, int layer = 0);
+	const std::vector<Color>& GetLayerPalette(int layer = 0) const;
+	const FrameStats& GetFrameStats() const;
 	void EnableBilinearFiltering(int layer = 0);
 	void DisableBilinearFiltering(int layer = 0);
 	int GetLayerCount() const;
@@ -157,51 +371,83 @@ public:
 	template <typename cbuffer>
 	void CreatePSConstantBuffer(const cbuffer& cbuf, int layer = 0)
 	{
-		D3D11_BUFFER_DESC bd = {};
-		bd.ByteWidth = sizeof(cbuffer);
-		bd.Usage = D3D11_USAGE_DYNAMIC;
-		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		bd.MiscFlags = 0;
-		bd.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA sd = {};
-		sd.pSysMem = &cbuf;
-		GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &Layers[layer].pPSCBUF));
+		CreateConstantBuffer(GraphicsBackend::ShaderStage::Pixel, &cbuf, (int)sizeof(cbuffer), layer);
 	}
 	template <typename cbuffer>
 	void UpdatePSConstantBuffer(const cbuffer& cbuf, int layer = 0) const
 	{
-		GFXCHECK(pPipeline->Map(Layers[layer].pPSCBUF.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
-		memcpy(msr.pData, &cbuf, sizeof(cbuffer));
-		pPipeline->Unmap(Layers[layer].pPSCBUF.Get(), 0);
+		UpdateConstantBuffer(GraphicsBackend::ShaderStage::Pixel, &cbuf, (int)sizeof(cbuffer), layer);
 	}
 	template <typename cbuffer>
 	void CreateVSConstantBuffer(const cbuffer& cbuf, int layer = 0)
 	{
-		D3D11_BUFFER_DESC bd = {};
-		bd.ByteWidth = sizeof(cbuffer);
-		bd.Usage = D3D11_USAGE_DYNAMIC;
-		bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		bd.MiscFlags = 0;
-		bd.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA sd = {};
-		sd.pSysMem = &cbuf;
-		GFXCHECK(pDevice->CreateBuffer(&bd, &sd, &Layers[layer].pVSCBUF));
+		CreateConstantBuffer(GraphicsBackend::ShaderStage::Vertex, &cbuf, (int)sizeof(cbuffer), layer);
 	}
 	template <typename cbuffer>
 	void UpdateVSConstantBuffer(const cbuffer& cbuf, int layer = 0) const
 	{
-		GFXCHECK(pPipeline->Map(Layers[layer].pVSCBUF.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &msr));
-		memcpy(msr.pData, &cbuf, sizeof(cbuffer));
-		pPipeline->Unmap(Layers[layer].pVSCBUF.Get(), 0);
+		UpdateConstantBuffer(GraphicsBackend::ShaderStage::Vertex, &cbuf, (int)sizeof(cbuffer), layer);
 	}
 	void SetPixel(int x, int y, Color color, int layer = 0);
 	const Color& GetPixel(int x, int y, int layer = 0) const;
+	void SetIndex(int x, int y, unsigned char index, int layer = 0);
+	unsigned char GetIndex(int x, int y, int layer = 0) const;
 	void DrawLine(vec2i p0, vec2i p1, const Color& color, int layer = 0);
-	void DrawLine(vec2i p0, vec2i p1, std::function<Color(int, int)> color_func, int layer = 0);
+	template <typename ColorFunc, typename = std::enable_if_t<std::is_invocable_r_v<Color, ColorFunc&, int, int>>>
+	void DrawLine(vec2i p0, vec2i p1, ColorFunc&& color_func, int layer = 0)
+	{
+		LineStepper line;
+		if (!BeginLine(p0, p1, layer, line))
+		{
+			return;
+		}
+		Layer& L = Layers[layer];
+		for (int i = 0; i < line.count; ++i, line.Advance())
+		{
+			L.pixelMap[line.y * L.width + line.x] = color_func(line.x, line.y);
+		}
+	}
 	void DrawCircle(int x, int y, int r, const Color& color, int layer = 0);
-	void DrawCircle(int x, int y, int r, std::function<Color(int, int)> color_func, int layer = 0);
+	template <typename ColorFunc, typename = std::enable_if_t<std::is_invocable_r_v<Color, ColorFunc&, int, int>>>
+	void DrawCircle(int x, int y, int r, ColorFunc&& color_func, int layer = 0)
+	{
+		assert(r > 0);
+		GenerateEllipseSpans(x, y, r, r);
+		ClipSpans(layer);
+		Layer& L = Layers[layer];
+		for (const Span& span : spans)
+		{
+			Color* const pRow = &L.pixelMap[span.y * L.width];
+			for (int lx = span.left; lx <= span.right; ++lx)
+			{
+				pRow[lx] = color_func(lx, span.y);
+			}
+		}
+	}
+	void DrawCircleOutline(int x, int y, int r, const Color& color, int layer = 0);
+	void DrawEllipse(int x, int y, int rx, int ry, const Color& color, int layer = 0);
+	void DrawEllipseOutline(int x, int y, int rx, int ry, const Color& color, int layer = 0);
+	void DrawRoundedRect(const iRect& rect, int radius, const Color& color, int layer = 0);
+	void DrawRoundedRectOutline(const iRect& rect, int radius, const Color& color, int layer = 0);
+	void DrawPolygon(const std::vector<vec2i>& points, const Color& color, int layer = 0);
+	void DrawPolygonOutline(const std::vector<vec2i>& points, const Color& color, int layer = 0);
+	// queued commands share the image's pixels until they are replayed by FlushCommands/EndFrame,
+	// so the image may be edited, reassigned or destroyed right after queueing without changing what is drawn
+	// commands replay by layer, then depth, then in the order they were queued
+	void QueueImage(const Image& image, int x, int y, int depth = 0, int layer = 0);
+	void QueueImage(const Image& image, const iRect& dest, int depth = 0, int layer = 0);
+	void QueueImageWithTransparency(const Image& image, int x, int y, int depth = 0, int layer = 0);
+	void QueueImageWithTransparency(const Image& image, const iRect& dest, int depth = 0, int layer = 0);
+	void QueueImageBlended(const Image& image, int x, int y, BlendMode mode, float opacity = 1.0f, int depth = 0, int layer = 0);
+	void QueueRect(const iRect& rect, const Color& color, int depth = 0, int layer = 0);
+	void QueueLine(vec2i p0, vec2i p1, const Color& color, int depth = 0, int layer = 0);
+	void QueueCircle(int x, int y, int r, const Color& color, int depth = 0, int layer = 0);
+	void QueueEllipse(int x, int y, int rx, int ry, const Color& color, int depth = 0, int layer = 0);
+	void FlushCommands();
+	int GetQueuedCommandCount() const;
+	const bool& isReplayingInParallel() const;
+	void EnableParallelReplay();
+	void DisableParallelReplay();
 	void SetFullscreen();
 	void ExitFullscreen();
 	bool isFullscreen();
@@ -229,6 +475,10 @@ public:
 	const int& GetSizeInBytes(int layer = 0) const;
 	const std::vector<Color>& GetPixelMap(int layer = 0) const;
 	std::vector<Color>& GetPixelMap(int layer = 0);
+	const std::vector<unsigned char>& GetIndexMap(int layer = 0) const;
+	std::vector<unsigned char>& GetIndexMap(int layer = 0);
+	const std::vector<unsigned short>& GetPackedMap(int layer = 0) const;
+	std::vector<unsigned short>& GetPackedMap(int layer = 0);
 	void SetViewport(int x, int y, int width, int height, int layer = 0);
 	void SetBackgroundColor(const Color& color);
 	Color GetBackgroundColor() const;
@@ -241,6 +491,9 @@ public:
 	void Scale(vec2 scalar, int layer = 0);
 	void SetScale(vec2 scale, int layer = 0);
 	const vec2& GetScale(int layer = 0) const;
+	// shows the layer as a torus starting at the given texel, so ring-buffered content scrolls without being moved
+	void SetWrapOrigin(vec2i origin, int layer = 0);
+	const vec2i& GetWrapOrigin(int layer = 0) const;
 	mat4 GetTransformationMatrix(int layer = 0) const;
 	mat4 GetPreTransformMatrix(int layer = 0) const;
 	mat4 GetPostTransformMatrix(int layer = 0) const;
@@ -0,0 +1,61 @@
+#pragma once
+#include "Color.h"
+#include "Shaders.h"
+#include <vector>
+
+class GraphicsBackend
+{
+public:
+	enum class ShaderStage
+	{
+		Vertex,
+		Pixel
+	};
+	struct DirtyRect
+	{
+		int left;
+		int top;
+		int right;
+		int bottom;
+	};
+	struct Viewport
+	{
+		float TopLeftX;
+		float TopLeftY;
+		float Width;
+		float Height;
+	};
+	struct LayerDesc
+	{
+		int width;
+		int height;
+		const Color* pPixels;
+		bool partialUploads;
+	};
+	struct LayerTransform
+	{
+		Viewport viewport;
+		vec2 position;
+		float rotation;
+		vec2 scale;
+		// texel shown at the layer's top-left corner; a non-zero origin samples the texture toroidally
+		vec2i wrapOrigin;
+	};
+public:
+	virtual ~GraphicsBackend() = default;
+	virtual void CreateLayer(int layer, const LayerDesc& desc) = 0;
+	virtual void UploadLayer(int layer, const Color* pPixels, int pitch) = 0;
+	virtual void UploadLayerRegion(int layer, const Color* pPixels, int pitch, const DirtyRect& region) = 0;
+	virtual void SetLayerFiltering(int layer, bool bilinear) = 0;
+	virtual void SetPixelShader(const Shader& shader, int layer) = 0;
+	virtual void SetVertexShader(const Shader& shader, int layer) = 0;
+	virtual void CreateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) = 0;
+	virtual void UpdateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) = 0;
+	virtual void BeginFrame(const float4& background) = 0;
+	virtual void DrawLayer(int layer, const LayerTransform& transform) = 0;
+	virtual void Present() = 0;
+	virtual bool ReadFrame(std::vector<Color>& pixels, int& width, int& height) = 0;
+	virtual void ResizeFrame(float x_scale, float y_scale) = 0;
+	virtual void SetFullscreen(bool fullscreen) = 0;
+	virtual bool isFullscreen() = 0;
+};
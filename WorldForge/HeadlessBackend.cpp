@@ -0,0 +1,353 @@
+#include "HeadlessBackend.h"
+#include "PixelKernels.h"
+#include "WorkerPool.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <assert.h>
+
+void HeadlessBackend::SampleRow(const LayerTexture& L, Color* pRow, double u, double v, double du, double dv, int count)
+{
+	const Color* const pTexels = L.texels.data();
+	for (int i = 0; i < count; ++i, u += du, v += dv)
+	{
+		if (u < 0.0 || v < 0.0 || u >= (double)L.width || v >= (double)L.height)
+		{
+			pRow[i] = Color(0, 0, 0, 0);
+		}
+		else if (!L.bilinear)
+		{
+			pRow[i] = pTexels[(int)v * L.width + (int)u];
+		}
+		else
+		{
+			const double su = u - 0.5;
+			const double sv = v - 0.5;
+			const int x0 = (int)floor(su);
+			const int y0 = (int)floor(sv);
+			const int fx = (int)((su - (double)x0) * 256.0);
+			const int fy = (int)((sv - (double)y0) * 256.0);
+			const int xa = std::clamp(x0, 0, L.width - 1);
+			const int xb = std::clamp(x0 + 1, 0, L.width - 1);
+			const int ya = std::clamp(y0, 0, L.height - 1) * L.width;
+			const int yb = std::clamp(y0 + 1, 0, L.height - 1) * L.width;
+			const unsigned char* const c00 = reinterpret_cast<const unsigned char*>(&pTexels[ya + xa]);
+			const unsigned char* const c10 = reinterpret_cast<const unsigned char*>(&pTexels[ya + xb]);
+			const unsigned char* const c01 = reinterpret_cast<const unsigned char*>(&pTexels[yb + xa]);
+			const unsigned char* const c11 = reinterpret_cast<const unsigned char*>(&pTexels[yb + xb]);
+			unsigned char* const out = reinterpret_cast<unsigned char*>(&pRow[i]);
+			for (int c = 0; c < 4; ++c)
+			{
+				const int top = c00[c] * (256 - fx) + c10[c] * fx;
+				const int bottom = c01[c] * (256 - fx) + c11[c] * fx;
+				out[c] = (unsigned char)((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+			}
+		}
+	}
+}
+
+void HeadlessBackend::SampleWrappedRow(const LayerTexture& L, Color* pRow, double u, double v, double du, double dv, int wrapX, int wrapY, int count)
+{
+	// the quad's extent still decides coverage, only the texel lookup wraps around
+	const Color* const pTexels = L.texels.data();
+	const auto wrap = [](int i, int n)
+	{
+		i %= n;
+		return i < 0 ? i + n : i;
+	};
+	for (int i = 0; i < count; ++i, u += du, v += dv)
+	{
+		if (u < 0.0 || v < 0.0 || u >= (double)L.width || v >= (double)L.height)
+		{
+			pRow[i] = Color(0, 0, 0, 0);
+		}
+		else if (!L.bilinear)
+		{
+			pRow[i] = pTexels[wrap((int)v + wrapY, L.height) * L.width + wrap((int)u + wrapX, L.width)];
+		}
+		else
+		{
+			const double su = u - 0.5;
+			const double sv = v - 0.5;
+			const int x0 = (int)floor(su);
+			const int y0 = (int)floor(sv);
+			const int fx = (int)((su - (double)x0) * 256.0);
+			const int fy = (int)((sv - (double)y0) * 256.0);
+			const int xa = wrap(x0 + wrapX, L.width);
+			const int xb = wrap(x0 + 1 + wrapX, L.width);
+			const int ya = wrap(y0 + wrapY, L.height) * L.width;
+			const int yb = wrap(y0 + 1 + wrapY, L.height) * L.width;
+			const unsigned char* const c00 = reinterpret_cast<const unsigned char*>(&pTexels[ya + xa]);
+			const unsigned char* const c10 = reinterpret_cast<const unsigned char*>(&pTexels[ya + xb]);
+			const unsigned char* const c01 = reinterpret_cast<const unsigned char*>(&pTexels[yb + xa]);
+			const unsigned char* const c11 = reinterpret_cast<const unsigned char*>(&pTexels[yb + xb]);
+			unsigned char* const out = reinterpret_cast<unsigned char*>(&pRow[i]);
+			for (int c = 0; c < 4; ++c)
+			{
+				const int top = c00[c] * (256 - fx) + c10[c] * fx;
+				const int bottom = c01[c] * (256 - fx) + c11[c] * fx;
+				out[c] = (unsigned char)((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+			}
+		}
+	}
+}
+
+void HeadlessBackend::BlendWrappedRow(const LayerTexture& L, Color* pDst, int x, int y, int count)
+{
+	const Color* const pRow = &L.texels[(size_t)y * L.width];
+	while (count > 0)
+	{
+		const int run = std::min(count, L.width - x);
+		PixelKernels::BlendRow(pDst, &pRow[x], run, BlendMode::SourceOver);
+		pDst += run;
+		count -= run;
+		x = 0;
+	}
+}
+
+void HeadlessBackend::CompositeTile(int tile)
+{
+	const int nTilesX = (frameWidth + tileSize - 1) / tileSize;
+	const int tileLeft = (tile % nTilesX) * tileSize;
+	const int tileTop = (tile / nTilesX) * tileSize;
+	const int tileRight = std::min(tileLeft + tileSize, frameWidth);
+	const int tileBottom = std::min(tileTop + tileSize, frameHeight);
+	if (needsClear)
+	{
+		for (int y = tileTop; y < tileBottom; ++y)
+		{
+			std::fill_n(&frameBuffer[(size_t)y * frameWidth + tileLeft], tileRight - tileLeft, backgroundColor);
+		}
+	}
+	thread_local std::vector<Color> rowBuffer;
+	rowBuffer.resize(tileSize);
+	for (const PendingLayer& P : pendingLayers)
+	{
+		const LayerTexture& L = Layers[P.layer];
+		const int left = std::max(P.left, tileLeft);
+		const int top = std::max(P.top, tileTop);
+		const int right = std::min(P.right, tileRight);
+		const int bottom = std::min(P.bottom, tileBottom);
+		if (left >= right || top >= bottom)
+		{
+			continue;
+		}
+		const int count = right - left;
+		for (int y = top; y < bottom; ++y)
+		{
+			Color* const pDst = &frameBuffer[(size_t)y * frameWidth + left];
+			if (P.isIdentity && P.isWrapped)
+			{
+				BlendWrappedRow(L, pDst, (left - P.texOffsetX + P.wrapX) % L.width, (y - P.texOffsetY + P.wrapY) % L.height, count);
+			}
+			else if (P.isIdentity)
+			{
+				PixelKernels::BlendRow(pDst, &L.texels[(size_t)(y - P.texOffsetY) * L.width + left - P.texOffsetX], count, BlendMode::SourceOver);
+			}
+			else
+			{
+				const double u = P.u00 + (double)left * P.dudx + (double)y * P.dudy;
+				const double v = P.v00 + (double)left * P.dvdx + (double)y * P.dvdy;
+				if (P.isWrapped)
+				{
+					SampleWrappedRow(L, rowBuffer.data(), u, v, P.dudx, P.dvdx, P.wrapX, P.wrapY, count);
+				}
+				else
+				{
+					SampleRow(L, rowBuffer.data(), u, v, P.dudx, P.dvdx, count);
+				}
+				PixelKernels::BlendRow(pDst, rowBuffer.data(), count, BlendMode::SourceOver);
+			}
+		}
+	}
+}
+
+void HeadlessBackend::Resolve()
+{
+	if (!needsClear && pendingLayers.empty())
+	{
+		return;
+	}
+	const int nTiles = ((frameWidth + tileSize - 1) / tileSize) * ((frameHeight + tileSize - 1) / tileSize);
+	WorkerPool::Shared().ParallelFor(nTiles, [this](int tile)
+	{
+		CompositeTile(tile);
+	});
+	pendingLayers.clear();
+	needsClear = false;
+}
+
+HeadlessBackend::HeadlessBackend(int FrameWidth, int FrameHeight)
+	:
+	frameWidth(FrameWidth),
+	frameHeight(FrameHeight)
+{
+	assert(FrameWidth > 0 && FrameHeight > 0);
+	frameBuffer.resize((size_t)frameWidth * frameHeight, backgroundColor);
+}
+
+const std::vector<Color>& HeadlessBackend::GetFrameBuffer() const
+{
+	return frameBuffer;
+}
+
+int HeadlessBackend::GetFrameWidth() const
+{
+	return frameWidth;
+}
+
+int HeadlessBackend::GetFrameHeight() const
+{
+	return frameHeight;
+}
+
+long long HeadlessBackend::GetFramesPresented() const
+{
+	return framesPresented;
+}
+
+void HeadlessBackend::CreateLayer(int layer, const LayerDesc& desc)
+{
+	if (layer >= (int)Layers.size())
+	{
+		Layers.resize(layer + 1);
+	}
+	LayerTexture& L = Layers[layer];
+	L.width = desc.width;
+	L.height = desc.height;
+	L.texels.assign(desc.pPixels, desc.pPixels + (size_t)desc.width * desc.height);
+}
+
+void HeadlessBackend::UploadLayer(int layer, const Color* pPixels, int pitch)
+{
+	LayerTexture& L = Layers[layer];
+	for (int y = 0; y < L.height; ++y)
+	{
+		memcpy(&L.texels[(size_t)y * L.width], (const char*)pPixels + (size_t)y * pitch, L.width * sizeof(Color));
+	}
+}
+
+void HeadlessBackend::UploadLayerRegion(int layer, const Color* pPixels, int pitch, const DirtyRect& region)
+{
+	LayerTexture& L = Layers[layer];
+	const int rowBytes = (region.right - region.left) * sizeof(Color);
+	for (int y = region.top; y < region.bottom; ++y)
+	{
+		const Color* const pSrc = (const Color*)((const char*)pPixels + (size_t)y * pitch) + region.left;
+		memcpy(&L.texels[(size_t)y * L.width + region.left], pSrc, rowBytes);
+	}
+}
+
+void HeadlessBackend::SetLayerFiltering(int layer, bool bilinear)
+{
+	Layers[layer].bilinear = bilinear;
+}
+
+void HeadlessBackend::SetPixelShader(const Shader& /*shader*/, int /*layer*/)
+{
+}
+
+void HeadlessBackend::SetVertexShader(const Shader& /*shader*/, int /*layer*/)
+{
+}
+
+void HeadlessBackend::CreateConstantBuffer(ShaderStage /*stage*/, const void* /*pData*/, int /*size*/, int /*layer*/)
+{
+}
+
+void HeadlessBackend::UpdateConstantBuffer(ShaderStage /*stage*/, const void* /*pData*/, int /*size*/, int /*layer*/)
+{
+}
+
+void HeadlessBackend::BeginFrame(const float4& background)
+{
+	backgroundColor = Color(background);
+	pendingLayers.clear();
+	needsClear = true;
+}
+
+void HeadlessBackend::DrawLayer(int layer, const LayerTransform& transform)
+{
+	const LayerTexture& L = Layers[layer];
+	const Viewport& vp = transform.viewport;
+	if (vp.Width <= 0.0f || vp.Height <= 0.0f || transform.scale.x == 0.0f || transform.scale.y == 0.0f)
+	{
+		return;
+	}
+	PendingLayer P = {};
+	P.layer = layer;
+	P.left = std::max(0, (int)ceil(vp.TopLeftX - 0.5f));
+	P.top = std::max(0, (int)ceil(vp.TopLeftY - 0.5f));
+	P.right = std::min(frameWidth, (int)ceil(vp.TopLeftX + vp.Width - 0.5f));
+	P.bottom = std::min(frameHeight, (int)ceil(vp.TopLeftY + vp.Height - 0.5f));
+	if (P.left >= P.right || P.top >= P.bottom)
+	{
+		return;
+	}
+	P.isIdentity =
+		transform.rotation == 0.0f &&
+		transform.scale.x == 1.0f && transform.scale.y == 1.0f &&
+		transform.position.x == 0.0f && transform.position.y == 0.0f &&
+		vp.Width == (float)L.width && vp.Height == (float)L.height &&
+		vp.TopLeftX == floor(vp.TopLeftX) && vp.TopLeftY == floor(vp.TopLeftY);
+	P.texOffsetX = (int)vp.TopLeftX;
+	P.texOffsetY = (int)vp.TopLeftY;
+	P.wrapX = ((transform.wrapOrigin.x % L.width) + L.width) % L.width;
+	P.wrapY = ((transform.wrapOrigin.y % L.height) + L.height) % L.height;
+	P.isWrapped = P.wrapX != 0 || P.wrapY != 0;
+	const double cosR = cos((double)transform.rotation);
+	const double sinR = sin((double)transform.rotation);
+	const double invSX = 1.0 / (double)transform.scale.x;
+	const double invSY = 1.0 / (double)transform.scale.y;
+	const auto toTexel = [&](double px, double py, double& u, double& v)
+	{
+		const double qx = ((px - (double)vp.TopLeftX) / (double)vp.Width) * 2.0 - 1.0 - (double)transform.position.x;
+		const double qy = 1.0 - ((py - (double)vp.TopLeftY) / (double)vp.Height) * 2.0 - (double)transform.position.y;
+		const double sx = qx * invSX;
+		const double sy = qy * invSY;
+		const double rx = sx * cosR + sy * sinR;
+		const double ry = -sx * sinR + sy * cosR;
+		u = (rx + 1.0) * 0.5 * (double)L.width;
+		v = (1.0 - ry) * 0.5 * (double)L.height;
+	};
+	double u10, v10, u01, v01;
+	toTexel(0.5, 0.5, P.u00, P.v00);
+	toTexel(1.5, 0.5, u10, v10);
+	toTexel(0.5, 1.5, u01, v01);
+	P.dudx = u10 - P.u00;
+	P.dvdx = v10 - P.v00;
+	P.dudy = u01 - P.u00;
+	P.dvdy = v01 - P.v00;
+	pendingLayers.push_back(P);
+}
+
+void HeadlessBackend::Present()
+{
+	Resolve();
+	++framesPresented;
+}
+
+bool HeadlessBackend::ReadFrame(std::vector<Color>& pixels, int& width, int& height)
+{
+	Resolve();
+	pixels = frameBuffer;
+	width = frameWidth;
+	height = frameHeight;
+	return true;
+}
+
+void HeadlessBackend::ResizeFrame(float x_scale, float y_scale)
+{
+	frameWidth = std::max(1, (int)((float)frameWidth * x_scale + 0.5f));
+	frameHeight = std::max(1, (int)((float)frameHeight * y_scale + 0.5f));
+	frameBuffer.assign((size_t)frameWidth * frameHeight, backgroundColor);
+}
+
+void HeadlessBackend::SetFullscreen(bool /*fullscreen*/)
+{
+}
+
+bool HeadlessBackend::isFullscreen()
+{
+	return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "GraphicsBackend.h"
+
+class HeadlessBackend : public GraphicsBackend
+{
+private:
+	struct LayerTexture
+	{
+		int width = 0;
+		int height = 0;
+		bool bilinear = false;
+		std::vector<Color> texels;
+	};
+	struct PendingLayer
+	{
+		int layer;
+		bool isIdentity;
+		bool isWrapped;
+		int left;
+		int top;
+		int right;
+		int bottom;
+		int texOffsetX;
+		int texOffsetY;
+		int wrapX;
+		int wrapY;
+		double u00;
+		double v00;
+		double dudx;
+		double dvdx;
+		double dudy;
+		double dvdy;
+	};
+private:
+	static constexpr int tileSize = 64;
+	int frameWidth;
+	int frameHeight;
+	std::vector<Color> frameBuffer;
+	std::vector<LayerTexture> Layers;
+	std::vector<PendingLayer> pendingLayers;
+	Color backgroundColor = Color(0, 0, 0, 255);
+	bool needsClear = true;
+	long long framesPresented = 0;
+private:
+	static void SampleRow(const LayerTexture& L, Color* pRow, double u, double v, double du, double dv, int count);
+	static void SampleWrappedRow(const LayerTexture& L, Color* pRow, double u, double v, double du, double dv, int wrapX, int wrapY, int count);
+	static void BlendWrappedRow(const LayerTexture& L, Color* pDst, int x, int y, int count);
+	void CompositeTile(int tile);
+	void Resolve();
+public:
+	HeadlessBackend(int FrameWidth, int FrameHeight);
+	const std::vector<Color>& GetFrameBuffer() const;
+	int GetFrameWidth() const;
+	int GetFrameHeight() const;
+	long long GetFramesPresented() const;
+	void CreateLayer(int layer, const LayerDesc& desc) override;
+	void UploadLayer(int layer, const Color* pPixels, int pitch) override;
+	void UploadLayerRegion(int layer, const Color* pPixels, int pitch, const DirtyRect& region) override;
+	void SetLayerFiltering(int layer, bool bilinear) override;
+	void SetPixelShader(const Shader& shader, int layer) override;
+	void SetVertexShader(const Shader& shader, int layer) override;
+	void CreateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) override;
+	void UpdateConstantBuffer(ShaderStage stage, const void* pData, int size, int layer) override;
+	void BeginFrame(const float4& background) override;
+	void DrawLayer(int layer, const LayerTransform& transform) override;
+	void Present() override;
+	bool ReadFrame(std::vector<Color>& pixels, int& width, int& height) override;
+	void ResizeFrame(float x_scale, float y_scale) override;
+	void SetFullscreen(bool fullscreen) override;
+	bool isFullscreen() override;
+};
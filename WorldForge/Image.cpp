@@ -1,27 +1,50 @@
 #include "Image.h"
+#include "PixelKernels.h"
+#include "ImageDecoder.h"
+#include "BitmapHeaders.h"
 #include <fstream>
 #include "BaseException.h"
-#include <wingdi.h>
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
 
-Image::Image(const Image& image)
+std::shared_ptr<Color[]> Image::AllocatePixels(int nPixels)
+{
+	return std::shared_ptr<Color[]>(new Color[nPixels]);
+}
+
+Color* Image::GetMutablePtrToImage()
+{
+	if (pImage.use_count() > 1)
+	{
+		std::shared_ptr<Color[]> pUnique = AllocatePixels(width * height);
+		const int nImageBytes = width * height * sizeof(Color);
+		memcpy(pUnique.get(), pImage.get(), nImageBytes);
+		pImage = std::move(pUnique);
+	}
+	return pImage.get();
+}
+
+Image::Image(Image&& image) noexcept
 	:
 	width(image.width),
 	height(image.height),
-	pImage(std::make_unique<Color[]>(width * height))
+	pImage(std::move(image.pImage))
 {
-	const int nImageBytes = width * height * sizeof(Color);
-	memcpy(pImage.get(), image.pImage.get(), nImageBytes);
+	image.width = 0;
+	image.height = 0;
 }
 
-Image& Image::operator=(const Image& image)
+Image& Image::operator=(Image&& image) noexcept
 {
-	width = image.width;
-	height = image.height;
-	const int nPixels = width * height;
-	pImage = std::make_unique<Color[]>(nPixels);
-	const int nImageBytes = nPixels * sizeof(Color);
-	memcpy(pImage.get(), image.pImage.get(), nImageBytes);
+	if (this != &image)
+	{
+		width = image.width;
+		height = image.height;
+		pImage = std::move(image.pImage);
+		image.width = 0;
+		image.height = 0;
+	}
 	return *this;
 }
 
@@ -29,7 +52,7 @@ Image::Image(int width, int height, Color color)
 	:
 	width(width),
 	height(height),
-	pImage(std::make_unique<Color[]>(width * height))
+	pImage(AllocatePixels(width * height))
 {
 	for (int i = 0; i < width * height; ++i)
 	{
@@ -39,83 +62,17 @@ Image::Image(int width, int height, Color color)
 
 Image::Image(const char* filename)
 {
-	std::ifstream bitmapIN{ filename, std::ios::binary };
-	if (bitmapIN.fail())
-	{
-		throw EXCPT_NOTE("Bitmap file not found! Check directory and/or file name spelling and retry.");
-	}
-	BITMAPFILEHEADER fileHead = {};
-	bitmapIN.read(reinterpret_cast<char*>(&fileHead), sizeof(fileHead));
-	if (fileHead.bfType != ('B' + ('M' << 8)))
-	{
-		throw EXCPT_NOTE("Only .bmp image files supported! Check image file extension and retry.");
-	}
-	BITMAPINFOHEADER infoHead = {};
-	bitmapIN.read(reinterpret_cast<char*>(&infoHead), sizeof(infoHead));
-	if (infoHead.biCompression != BI_RGB)
-	{
-		throw EXCPT_NOTE("Only uncompressed bitmaps supported! Decompress image and retry.");
-	}
-	if (infoHead.biBitCount != 24 && infoHead.biBitCount != 32)
-	{
-		throw EXCPT_NOTE("Only bitmaps of either 24bpp or 32bpp allowed. Reset color depth of image and retry.");
-	}
-	bitmapIN.seekg(fileHead.bfOffBits, std::ios::beg);
-	width = infoHead.biWidth;
-	height = std::abs(infoHead.biHeight);
-	const int nPixels = width * height;
-	const int nImageBytes = nPixels * sizeof(Color);
-	pImage = std::make_unique<Color[]>(nPixels);
-	if (infoHead.biBitCount == 32 && infoHead.biHeight < 0)
-	{
-		bitmapIN.read(reinterpret_cast<char*>(pImage.get()), nImageBytes);
-	}
-	else
-	{
-		int padding = 0;
-		if (infoHead.biBitCount == 24)
-		{
-			padding = (4 - ((width * 3) % 4)) % 4;
-		}
-		int startY = 0;
-		int deltaY = 1;
-		int endY = height;
-		if (infoHead.biHeight > 0)
-		{
-			startY = height - 1;
-			deltaY = -1;
-			endY = -1;
-		}
-		for (int y = startY; y != endY; y += deltaY)
-		{
-			for (int x = 0; x < width; ++x)
-			{
-				const int pxl = y * width + x;
-				if (infoHead.biBitCount == 24)
-				{
-					bitmapIN.read(reinterpret_cast<char*>(&pImage[pxl]), sizeof(Color) - 1);
-					pImage[pxl].SetA(255);
-				}
-				else
-				{
-					bitmapIN.read(reinterpret_cast<char*>(&pImage[pxl]), sizeof(Color));
-				}
-			}
-			bitmapIN.seekg(padding, std::ios::cur);
-		}
-	}
-	if (bitmapIN.fail())
-	{
-		throw EXCPT_NOTE("Critical error in reading bitmap file! Please retry.");
-	}
-	bitmapIN.close();
+	DecodedImage decoded = ImageDecoder::DecodeFile(filename);
+	width = decoded.width;
+	height = decoded.height;
+	pImage = std::move(decoded.pPixels);
 }
 
 Image::Image(const std::vector<Color>& image, int image_width)
 	:
 	width(image_width),
 	height((int)image.size() / width),
-	pImage(std::make_unique<Color[]>(image.size()))
+	pImage(AllocatePixels((int)image.size()))
 {
 	const int nImageBytes = (int)image.size() * sizeof(Color);
 	memcpy(pImage.get(), image.data(), nImageBytes);
@@ -141,11 +98,16 @@ const Color* Image::GetPtrToImage() const
 	return pImage.get();
 }
 
+std::shared_ptr<const Color[]> Image::SharePixels() const
+{
+	return pImage;
+}
+
 void Image::SetPixel(int x, int y, const Color& color)
 {
 	assert(x < width && y < height);
 	const int pxl = y * width + x;
-	pImage[pxl] = color;
+	GetMutablePtrToImage()[pxl] = color;
 }
 
 const Color& Image::GetPixel(int x, int y) const
@@ -175,261 +137,350 @@ Image& Image::Crop(int new_width, int new_height, int x_off, int y_off)
 	return *this = this->Cropped(new_width, new_height, x_off, y_off);
 }
 
-Image Image::FlippedV() const
+void Image::Paste(const Image& image, int x_off, int y_off)
+{
+	assert(x_off >= 0 && x_off + image.width <= width);
+	assert(y_off >= 0 && y_off + image.height <= height);
+	Color* const pPixels = GetMutablePtrToImage();
+	const int pitch = image.width * sizeof(Color);
+	for (int y = 0; y < image.height; ++y)
+	{
+		const int dst_pxl = (y + y_off) * width + x_off;
+		const int src_pxl = y * image.width;
+		memcpy(&pPixels[dst_pxl], &image.pImage[src_pxl], pitch);
+	}
+}
+
+static void FlipRowsV(Color* pPixels, int width, int height)
+{
+	for (int y = 0; y < height / 2; ++y)
+	{
+		Color* const pTop = &pPixels[y * width];
+		Color* const pBottom = &pPixels[(height - y - 1) * width];
+		std::swap_ranges(pTop, pTop + width, pBottom);
+	}
+}
+
+static void ReverseRows(Color* pPixels, int width, int height)
 {
-	Image flippedV{ width,height };
 	for (int y = 0; y < height; ++y)
 	{
-		for (int x = 0; x < width; ++x)
+		std::reverse(&pPixels[y * width], &pPixels[y * width] + width);
+	}
+}
+
+static void TransposeSquare(Color* pPixels, int size)
+{
+	constexpr int blockSize = 16;
+	for (int by = 0; by < size; by += blockSize)
+	{
+		const int endY = std::min(by + blockSize, size);
+		for (int bx = by; bx < size; bx += blockSize)
 		{
-			const int dst_pxl = y * width + x;
-			const int src_pxl = (height - y - 1) * width + x;
-			flippedV.pImage[dst_pxl] = pImage[src_pxl];
+			const int endX = std::min(bx + blockSize, size);
+			for (int y = by; y < endY; ++y)
+			{
+				const int startX = (bx == by) ? y + 1 : bx;
+				for (int x = startX; x < endX; ++x)
+				{
+					std::swap(pPixels[y * size + x], pPixels[x * size + y]);
+				}
+			}
 		}
 	}
-	return flippedV;
 }
 
-Image& Image::FlipV()
+static void ApplyChromaKey(Color* dst, const Color* src, int nPixels, const Color& chroma)
 {
-	return *this = this->FlippedV();
+	for (int i = 0; i < nPixels; ++i)
+	{
+		dst[i] = (src[i] == chroma) ? Colors::Transparent : src[i];
+	}
 }
 
-Image Image::FlippedH() const
+static void ApplyInversion(Color* dst, const Color* src, int nPixels)
 {
-	Image flippedH{ width,height };
-	for (int y = 0; y < height; ++y)
+	for (int i = 0; i < nPixels; ++i)
 	{
-		for (int x = 0; x < width; ++x)
+		dst[i] = src[i].GetA() ? src[i].Inverted() : Colors::Transparent;
+	}
+}
+
+static void ApplyMonochrome(Color* dst, const Color* src, int nPixels, const Color& color)
+{
+	for (int i = 0; i < nPixels; ++i)
+	{
+		dst[i] = src[i].GetA() ? color : Colors::Transparent;
+	}
+}
+
+static void ApplyColorScale(Color* dst, const Color* src, int nPixels, const Color& scale)
+{
+	const float scaleR = scale.GetRn();
+	const float scaleG = scale.GetGn();
+	const float scaleB = scale.GetBn();
+	for (int i = 0; i < nPixels; ++i)
+	{
+		if (src[i].GetA())
 		{
-			const int dst_pxl = y * width + x;
-			const int src_pxl = y * width + (width - x - 1);
-			flippedH.pImage[dst_pxl] = pImage[src_pxl];
+			const float pxl_avg = (src[i].GetRn() + src[i].GetGn() + src[i].GetBn()) / 3.0f;
+			dst[i] = Color(pxl_avg * scaleR, pxl_avg * scaleG, pxl_avg * scaleB);
+		}
+		else
+		{
+			dst[i] = Colors::Transparent;
 		}
 	}
-	return flippedH;
 }
 
-Image& Image::FlipH()
+static void ApplyFilter(Color* dst, const Color* src, int nPixels, const Color& filter)
 {
-	return *this = this->FlippedH();
+	const vec4 vFilter = filter.GetVector();
+	for (int i = 0; i < nPixels; ++i)
+	{
+		dst[i] = src[i] * vFilter;
+	}
 }
 
-Image Image::Rotated90() const
+static void ApplyMosaic(Color* dst, const Color* src, int width, int height, int2 img_divs)
 {
-	Image rotated{ height,width };
+	const int pxlsPerDivY = height / img_divs.y;
+	const int pxlsPerDivX = width / img_divs.x;
 	for (int y = 0; y < height; ++y)
 	{
+		const int row = y * width;
+		const int mos_row = (y / pxlsPerDivY * pxlsPerDivY) * width;
 		for (int x = 0; x < width; ++x)
 		{
-			const int src_pxl = y * width + x;
-			const int dst_pxl = (width - x - 1) * height + y;
-			rotated.pImage[dst_pxl] = pImage[src_pxl];
+			const int mos_x = x / pxlsPerDivX * pxlsPerDivX;
+			dst[row + x] = src[mos_row + mos_x];
+		}
+	}
+}
+
+static void ApplySilhouette(Color* dst, const Color* src, int nPixels, const Color& background, const Color& silhouette)
+{
+	for (int i = 0; i < nPixels; ++i)
+	{
+		if (src[i].GetA())
+		{
+			dst[i] = (src[i] != background) ? silhouette : background;
+		}
+		else
+		{
+			dst[i] = Colors::Transparent;
 		}
 	}
+}
+
+Image Image::FlippedV() const
+{
+	Image flippedV{ *this };
+	flippedV.FlipV();
+	return flippedV;
+}
+
+Image& Image::FlipV()
+{
+	FlipRowsV(GetMutablePtrToImage(), width, height);
+	return *this;
+}
+
+Image Image::FlippedH() const
+{
+	Image flippedH{ *this };
+	flippedH.FlipH();
+	return flippedH;
+}
+
+Image& Image::FlipH()
+{
+	ReverseRows(GetMutablePtrToImage(), width, height);
+	return *this;
+}
+
+Image Image::Rotated90() const
+{
+	Image rotated{ height,width };
+	PixelKernels::Transpose(&rotated.pImage[(width - 1) * height], -height, pImage.get(), width, width, height);
 	return rotated;
 }
 
 Image& Image::Rotate90()
 {
-	return *this = this->Rotated90();
+	if (width != height)
+	{
+		return *this = this->Rotated90();
+	}
+	Color* const pPixels = GetMutablePtrToImage();
+	TransposeSquare(pPixels, width);
+	FlipRowsV(pPixels, width, height);
+	return *this;
 }
 
 Image Image::Rotated180() const
 {
-	Image rotated{ width,height };
-	for (int y = 0; y < height; ++y)
-	{
-		for (int x = 0; x < width; ++x)
-		{
-			const int src_pxl = y * width + x;
-			const int dst_pxl = (height - y - 1) * width + (width - x - 1);
-			rotated.pImage[dst_pxl] = pImage[src_pxl];
-		}
-	}
+	Image rotated{ *this };
+	rotated.Rotate180();
 	return rotated;
 }
 
 Image& Image::Rotate180()
 {
-	return *this = this->Rotated180();
+	Color* const pPixels = GetMutablePtrToImage();
+	std::reverse(pPixels, pPixels + width * height);
+	return *this;
 }
 
 Image Image::Rotated270() const
 {
 	Image rotated{ height,width };
-	for (int y = 0; y < height; ++y)
-	{
-		for (int x = 0; x < width; ++x)
-		{
-			const int src_pxl = y * width + x;
-			const int dst_pxl = x * height + (height - y - 1);
-			rotated.pImage[dst_pxl] = pImage[src_pxl];
-		}
-	}
+	PixelKernels::Transpose(rotated.pImage.get(), height, &pImage[(height - 1) * width], -width, width, height);
 	return rotated;
 }
 
 Image& Image::Rotate270()
 {
-	return *this = this->Rotated270();
+	if (width != height)
+	{
+		return *this = this->Rotated270();
+	}
+	Color* const pPixels = GetMutablePtrToImage();
+	TransposeSquare(pPixels, width);
+	ReverseRows(pPixels, width, height);
+	return *this;
 }
 
-Image Image::AdjustedSize(float x_adjust, float y_adjust) const
+Image Image::Transposed() const
 {
-	float newWidth = (float)width * x_adjust;
-	float newHeight = (float)height * y_adjust;
-	Image adjusted{ int(newWidth), int(newHeight) };
-	const float xPxlsPerPxl = (float)width / newWidth;
-	const float yPxlsPerPxl = (float)height / newHeight;
-	for (int y = 0; y < adjusted.height; ++y)
+	Image transposed{ height,width };
+	PixelKernels::Transpose(transposed.pImage.get(), height, pImage.get(), width, width, height);
+	return transposed;
+}
+
+Image& Image::Transpose()
+{
+	if (width != height)
 	{
-		for (int x = 0; x < adjusted.height; ++x)
-		{
-			adjusted.pImage[y * adjusted.width + x] = pImage[int((float)y * yPxlsPerPxl) * width + int((float)x * xPxlsPerPxl)];
-		}
+		return *this = this->Transposed();
 	}
-	return adjusted;
+	TransposeSquare(GetMutablePtrToImage(), width);
+	return *this;
+}
+
+Image Image::Resized(int new_width, int new_height, ResampleFilter filter) const
+{
+	assert(new_width > 0 && new_height > 0);
+	Image resized{ new_width,new_height };
+	PixelKernels::Resample(resized.pImage.get(), new_width, new_height, pImage.get(), width, height, filter);
+	return resized;
+}
+
+Image& Image::Resize(int new_width, int new_height, ResampleFilter filter)
+{
+	return *this = this->Resized(new_width, new_height, filter);
+}
+
+Image Image::AdjustedSize(float x_adjust, float y_adjust, ResampleFilter filter) const
+{
+	return Resized(int((float)width * x_adjust), int((float)height * y_adjust), filter);
 }
 
-Image& Image::AdjustSize(float x_adjust, float y_adjust)
+Image& Image::AdjustSize(float x_adjust, float y_adjust, ResampleFilter filter)
 {
-	return *this = this->AdjustedSize(x_adjust, y_adjust);
+	return *this = this->AdjustedSize(x_adjust, y_adjust, filter);
 }
 
 Image Image::WithAddedTransparencyFromChroma(const Color& chroma) const
 {
 	Image transparentCopy{ width,height };
-	for (int y = 0; y < height; ++y)
-	{
-		for (int x = 0; x < width; ++x)
-		{
-			const int pxl = y * width + x;
-			if (pImage[pxl] == chroma)
-			{
-				transparentCopy.pImage[pxl] = Colors::Transparent;
-			}
-			else
-			{
-				transparentCopy.pImage[pxl] = pImage[pxl];
-			}
-		}
-	}
+	ApplyChromaKey(transparentCopy.pImage.get(), pImage.get(), width * height, chroma);
 	return transparentCopy;
 }
 
 Image& Image::AddTransparencyFromChroma(const Color& chroma)
 {
-	return *this = this->WithAddedTransparencyFromChroma(chroma);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyChromaKey(pPixels, pPixels, width * height, chroma);
+	return *this;
 }
 
 Image Image::WithInvertedColors() const
 {
 	Image inverted{ width,height };
-	for (int i = 0; i < width * height; ++i)
-	{
-		if (pImage[i].GetA())
-		{
-			inverted.pImage[i] = pImage[i].Inverted();
-		}
-		else
-		{
-			inverted.pImage[i] = Colors::Transparent;
-		}
-	}
+	ApplyInversion(inverted.pImage.get(), pImage.get(), width * height);
 	return inverted;
 }
 
 Image& Image::InvertColors()
 {
-	return *this = this->WithInvertedColors();
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyInversion(pPixels, pPixels, width * height);
+	return *this;
 }
 
 Image Image::WithSubstitutedColors(std::vector<Color> targets, std::vector<Color> replacements) const
 {
 	assert(targets.size() <= replacements.size());
+	std::vector<unsigned int> keys;
+	std::vector<Color> values;
+	PixelKernels::BuildRemapTable(targets, replacements, keys, values);
 	Image substituted{ width,height };
-	for (int i = 0; i < width * height; ++i)
-	{
-		for (int j = 0; j < targets.size(); ++j)
-		{
-			if (pImage[i] == targets[j])
-			{
-				substituted.pImage[i] = replacements[j];
-			}
-			else
-			{
-				substituted.pImage[i] = pImage[i];
-			}
-		}
-	}
+	PixelKernels::RemapRow(substituted.pImage.get(), pImage.get(), width * height, keys.data(), values.data(), (int)keys.size());
 	return substituted;
 }
 
 Image& Image::SubstituteColors(std::vector<Color> targets, std::vector<Color> replacements)
 {
-	return *this = this->WithSubstitutedColors(targets, replacements);
+	assert(targets.size() <= replacements.size());
+	std::vector<unsigned int> keys;
+	std::vector<Color> values;
+	PixelKernels::BuildRemapTable(targets, replacements, keys, values);
+	Color* const pPixels = GetMutablePtrToImage();
+	PixelKernels::RemapRow(pPixels, pPixels, width * height, keys.data(), values.data(), (int)keys.size());
+	return *this;
 }
 
 Image Image::Monochromatic(const Color& color) const
 {
 	Image monochromatic{ width,height };
-	for (int i = 0; i < width * height; ++i)
-	{
-		if (pImage[i].GetA())
-		{
-			monochromatic.pImage[i] = color;
-		}
-		else
-		{
-			monochromatic.pImage[i] = Colors::Transparent;
-		}
-	}
+	ApplyMonochrome(monochromatic.pImage.get(), pImage.get(), width * height, color);
 	return monochromatic;
 }
 
 Image& Image::MakeMonochromatic(const Color& color)
 {
-	return *this = this->Monochromatic(color);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyMonochrome(pPixels, pPixels, width * height, color);
+	return *this;
 }
 
 Image Image::ColorScaled(const Color& scale) const
 {
 	Image scaled{ width,height };
-	for (int i = 0; i < width * height; ++i)
-	{
-		if (pImage[i].GetA())
-		{
-			const float pxl_avg = (pImage[i].GetRn() + pImage[i].GetGn() + pImage[i].GetBn()) / 3.0f;
-			scaled.pImage[i] = Color(pxl_avg * scale.GetRn(), pxl_avg * scale.GetGn(), pxl_avg * scale.GetBn());
-		}
-		else
-		{
-			scaled.pImage[i] = Colors::Transparent;
-		}
-	}
+	ApplyColorScale(scaled.pImage.get(), pImage.get(), width * height, scale);
 	return scaled;
 }
 
 Image& Image::ColorScale(const Color& scale)
 {
-	return *this = this->ColorScaled(scale);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyColorScale(pPixels, pPixels, width * height, scale);
+	return *this;
 }
 
 Image Image::Filtered(const Color& filter) const
 {
 	Image filtered{ width,height };
-	vec4 vFilter = filter.GetVector();
-	for (int i = 0; i < width * height; ++i)
-	{
-		filtered.pImage[i] = pImage[i] * vFilter;
-	}
+	ApplyFilter(filtered.pImage.get(), pImage.get(), width * height, filter);
 	return filtered;
 }
 
 Image& Image::Filter(const Color& filter)
 {
-	return *this = this->Filtered(filter);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyFilter(pPixels, pPixels, width * height, filter);
+	return *this;
 }
 
 Image Image::WithMosaicEffect(int2 img_divs) const
@@ -437,54 +488,45 @@ Image Image::WithMosaicEffect(int2 img_divs) const
 	assert(height % img_divs.y == 0);
 	assert(width % img_divs.x == 0);
 	Image mosaic{ width,height };
-	const int pxlsPerDivY = height / img_divs.y;
-	const int pxlsPerDivX = width / img_divs.x;
-	for (int y = 0; y < height; ++y)
-	{
-		const int row = y * width;
-		const int mos_y = y / pxlsPerDivY * pxlsPerDivY;
-		const int mos_row = mos_y * width;
-		for (int x = 0; x < width; ++x)
-		{
-			const int mos_x = x / pxlsPerDivX * pxlsPerDivX;
-			mosaic.pImage[row + x] = pImage[mos_row + mos_x];
-		}
-	}
+	ApplyMosaic(mosaic.pImage.get(), pImage.get(), width, height, img_divs);
 	return mosaic;
 }
 
 Image& Image::MakeMosaic(int2 img_divs)
 {
-	return *this = this->WithMosaicEffect(img_divs);
+	assert(height % img_divs.y == 0);
+	assert(width % img_divs.x == 0);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplyMosaic(pPixels, pPixels, width, height, img_divs);
+	return *this;
 }
 
 Image Image::Silhouetted(const Color& background, const Color& silhouette) const
 {
 	Image silhouetted{ width,height };
-	for (int i = 0; i < width * height; ++i)
-	{
-		if (pImage[i].GetA())
-		{
-			if (pImage[i] != background)
-			{
-				silhouetted.pImage[i] = silhouette;
-			}
-			else
-			{
-				silhouetted.pImage[i] = background;
-			}
-		}
-		else
-		{
-			silhouetted.pImage[i] = Colors::Transparent;
-		}
-	}
+	ApplySilhouette(silhouetted.pImage.get(), pImage.get(), width * height, background, silhouette);
 	return silhouetted;
 }
 
 Image& Image::Silhouette(const Color& background, const Color& silhouette)
 {
-	return *this = this->Silhouetted(background, silhouette);
+	Color* const pPixels = GetMutablePtrToImage();
+	ApplySilhouette(pPixels, pPixels, width * height, background, silhouette);
+	return *this;
+}
+
+Image Image::Premultiplied() const
+{
+	Image premultiplied{ width,height };
+	PixelKernels::PremultiplyRow(premultiplied.pImage.get(), pImage.get(), width * height);
+	return premultiplied;
+}
+
+Image& Image::Premultiply()
+{
+	Color* const pPixels = GetMutablePtrToImage();
+	PixelKernels::PremultiplyRow(pPixels, pPixels, width * height);
+	return *this;
 }
 
 void Image::Load(const char* filename)
@@ -496,33 +538,33 @@ void Image::Save(const char* filename) const
 {
 	const int nPixels = width * height;
 	const int nImageBytes = nPixels * sizeof(Color);
-	const int headerSectionSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
-	std::ofstream bitmapOUT{ filename, std::ios::binary };
-	if (bitmapOUT.fail())
-	{
-		throw EXCPT_NOTE("Cannot write to specified file! Check directory and/or file name spelling and retry.");
-	}
-	BITMAPFILEHEADER fileHead;
+	const int headerSectionSize = sizeof(BitmapFileHeader) + sizeof(BitmapInfoHeader);
+	BitmapFileHeader fileHead;
 	fileHead.bfType = 'B' + ('M' << 8);
 	fileHead.bfSize = headerSectionSize + nImageBytes;
 	fileHead.bfReserved1 = 0;
 	fileHead.bfReserved2 = 0;
 	fileHead.bfOffBits = headerSectionSize;
-	BITMAPINFOHEADER infoHead;
-	infoHead.biSize = sizeof(BITMAPINFOHEADER);
+	BitmapInfoHeader infoHead;
+	infoHead.biSize = sizeof(BitmapInfoHeader);
 	infoHead.biWidth = width;
 	infoHead.biHeight = -int(height);	// Top-down DIB
 	infoHead.biPlanes = 1;				// Always set to 1
 	infoHead.biBitCount = 32;
-	infoHead.biCompression = BI_RGB; 
+	infoHead.biCompression = BitmapCompressionRGB;
 	infoHead.biSizeImage = nImageBytes;
 	infoHead.biXPelsPerMeter = 0;		// No target device
 	infoHead.biYPelsPerMeter = 0;		// No target device
 	infoHead.biClrUsed = 0;				// Use all possible colors
 	infoHead.biClrImportant = 0;		// All colors are required
-	bitmapOUT.write(reinterpret_cast<char*>(&fileHead), sizeof(BITMAPFILEHEADER));
-	bitmapOUT.write(reinterpret_cast<char*>(&infoHead), sizeof(BITMAPINFOHEADER));
-	bitmapOUT.write(reinterpret_cast<char*>(pImage.get()), nImageBytes);
+	std::ofstream bitmapOUT{ filename, std::ios::binary };
+	if (bitmapOUT.fail())
+	{
+		throw EXCPT_NOTE("Cannot write to specified file! Check directory and/or file name spelling and retry.");
+	}
+	bitmapOUT.write(reinterpret_cast<char*>(&fileHead), sizeof(BitmapFileHeader));
+	bitmapOUT.write(reinterpret_cast<char*>(&infoHead), sizeof(BitmapInfoHeader));
+	bitmapOUT.write(reinterpret_cast<const char*>(pImage.get()), nImageBytes);
 	if (bitmapOUT.fail())
 	{
 		throw EXCPT_NOTE("Critical error writing bitmap file! Please retry.");
@@ -545,10 +587,11 @@ std::vector<Color> Image::Export() const
 	return image;
 }
 
-void Image::Draw(Graphics& gfx, int X, int Y, int layer) const
+void Image::DrawScaled(Graphics& gfx, int X, int Y, int width, int height, bool transparency, int layer) const
 {
 	const int& xRes = gfx.GetWidth(layer);
 	const int& yRes = gfx.GetHeight(layer);
+	assert(width > 0 && height > 0);
 	assert(X < (int)xRes && X + width > 0);
 	assert(Y < (int)yRes && Y + height > 0);
 	const int startX =
@@ -557,49 +600,109 @@ void Image::Draw(Graphics& gfx, int X, int Y, int layer) const
 	const int startY =
 		(0) * (Y >= 0) +
 		(-Y) * (Y < 0);
-	const int slicePitch =
-		((xRes - X - startX) * sizeof(Color)) * (width + X > xRes) +
-		((width - startX) * sizeof(Color)) * (width + X <= xRes);
+	const int endX =
+		(xRes - X) * (width + X > xRes) +
+		(width) * (width + X <= xRes);
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	const int nCols = endX - startX;
+	const bool unscaledX = (width == this->width);
+	thread_local std::vector<int> srcCols;
+	thread_local std::vector<Color> srcRowBuffer;
+	if (!unscaledX)
+	{
+		srcCols.resize(nCols);
+		PixelKernels::NearestIndices(srcCols.data(), startX, nCols, width, this->width);
+		srcRowBuffer.resize(nCols);
+	}
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
+	int prevSrcY = -1;
 	for (int y = startY; y < endY; ++y)
 	{
-		const int dst_pxl = (Y + y) * xRes + X + startX;
-		const int src_pxl = y * width + startX;
-		memcpy(&gfx.GetPixelMap(layer)[dst_pxl], &pImage[src_pxl], slicePitch);
+		Color* const pDstRow = &pPixelMap[(Y + y) * xRes + X + startX];
+		const int srcY = PixelKernels::NearestIndex(y, height, this->height);
+		const Color* const pImageRow = &pImage[srcY * this->width];
+		if (!transparency)
+		{
+			if (srcY == prevSrcY)
+			{
+				memcpy(pDstRow, pDstRow - xRes, nCols * sizeof(Color));
+			}
+			else if (unscaledX)
+			{
+				PixelKernels::CopyRow(pDstRow, pImageRow + startX, nCols);
+			}
+			else
+			{
+				PixelKernels::GatherRow(pDstRow, pImageRow, srcCols.data(), nCols);
+			}
+		}
+		else if (unscaledX)
+		{
+			PixelKernels::CopyRowWithTransparency(pDstRow, pImageRow + startX, nCols);
+		}
+		else
+		{
+			if (srcY != prevSrcY)
+			{
+				PixelKernels::GatherRow(srcRowBuffer.data(), pImageRow, srcCols.data(), nCols);
+			}
+			PixelKernels::CopyRowWithTransparency(pDstRow, srcRowBuffer.data(), nCols);
+		}
+		prevSrcY = srcY;
 	}
 }
 
-void Image::Draw(Graphics& gfx, int X, int Y, int width, int height, int layer) const
+void Image::Draw(Graphics& gfx, int X, int Y, int layer) const
 {
 	const int& xRes = gfx.GetWidth(layer);
 	const int& yRes = gfx.GetHeight(layer);
-	assert(width != 0 && height != 0);
 	assert(X < (int)xRes && X + width > 0);
 	assert(Y < (int)yRes && Y + height > 0);
-	const float xPxlsPerPxl = (float)this->width / (float)width;
-	const float yPxlsPerPxl = (float)this->height / (float)height;
 	const int startX =
 		(0) * (X >= 0) +
 		(-X) * (X < 0);
 	const int startY =
 		(0) * (Y >= 0) +
 		(-Y) * (Y < 0);
-	const int endX =
-		(xRes - X) * (width + X > xRes) +
-		(width) * (width + X <= xRes);
+	const int slicePitch =
+		((xRes - X - startX) * sizeof(Color)) * (width + X > xRes) +
+		((width - startX) * sizeof(Color)) * (width + X <= xRes);
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, slicePitch / (int)sizeof(Color), endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
-		for (int x = startX; x < endX; ++x)
-		{
-			const int dest_pxl = (Y + y) * xRes + X + x;
-			const int src_pxl = int((float)y * yPxlsPerPxl) * this->width + int((float)x * xPxlsPerPxl);
-			gfx.GetPixelMap(layer)[dest_pxl] = pImage[src_pxl];
-		}
+		const int dst_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		memcpy(&gfx.GetPixelMap(layer)[dst_pxl], &pImage[src_pxl], slicePitch);
+	}
+}
+
+void Image::Draw(Graphics& gfx, int X, int Y, int width, int height, int layer) const
+{
+	DrawScaled(gfx, X, Y, width, height, false, layer);
+}
+
+void Image::DrawRegion(Graphics& gfx, int X, int Y, const iRect& region, int layer) const
+{
+	const int& xRes = gfx.GetWidth(layer);
+	const int& yRes = gfx.GetHeight(layer);
+	assert(region.pos.x >= 0 && region.pos.x + region.width <= width);
+	assert(region.pos.y >= 0 && region.pos.y + region.height <= height);
+	assert(X >= 0 && X + region.width <= xRes);
+	assert(Y >= 0 && Y + region.height <= yRes);
+	gfx.MarkDirty(iRect({ X,Y }, region.width, region.height), layer);
+	Color* const pDst = gfx.GetPixelMap(layer).data();
+	const int slicePitch = region.width * sizeof(Color);
+	for (int y = 0; y < region.height; ++y)
+	{
+		const int dst_pxl = (Y + y) * xRes + X;
+		const int src_pxl = (region.pos.y + y) * width + region.pos.x;
+		memcpy(&pDst[dst_pxl], &pImage[src_pxl], slicePitch);
 	}
 }
 
@@ -617,10 +720,11 @@ void Image::Draw(Graphics& gfx, int X, int Y, std::function<Color(const Image&,
 		(-Y) * (Y < 0);
 	const int endX =
 		(xRes - X) * (width + X > xRes) +
-		(width) * (height + X <= xRes);
+		(width) * (width + X <= xRes);
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
 		for (int x = startX; x < endX; ++x)
@@ -653,6 +757,7 @@ void Image::Draw(Graphics& gfx, int X, int Y, int width, int height, std::functi
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
 		for (int x = startX; x < endX; ++x)
@@ -680,33 +785,31 @@ void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int layer) const
 		(-Y) * (Y < 0);
 	const int endX =
 		(xRes - X) * (width + X > xRes) +
-		(width) * (height + X <= xRes);
+		(width) * (width + X <= xRes);
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
-		for (int x = startX; x < endX; ++x)
-		{
-			const int src_pxl = y * width + x;
-			if (pImage[src_pxl].GetA())
-			{
-				const int dest_pxl = (Y + y) * xRes + X + x;
-				gfx.GetPixelMap(layer)[dest_pxl] = pImage[src_pxl];
-			}
-		}
+		const int dest_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		PixelKernels::CopyRowWithTransparency(&pPixelMap[dest_pxl], &pImage[src_pxl], endX - startX);
 	}
 }
 
 void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int height, int layer) const
+{
+	DrawScaled(gfx, X, Y, width, height, true, layer);
+}
+
+void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, std::function<Color(const Image&, int, int, int)> color_func, int layer) const
 {
 	const int& xRes = gfx.GetWidth(layer);
 	const int& yRes = gfx.GetHeight(layer);
-	assert(width != 0 && height != 0);
 	assert(X < (int)xRes && X + width > 0);
 	assert(Y < (int)yRes && Y + height > 0);
-	const float xPxlsPerPxl = (float)this->width / (float)width;
-	const float yPxlsPerPxl = (float)this->height / (float)height;
 	const int startX =
 		(0) * (X >= 0) +
 		(-X) * (X < 0);
@@ -719,26 +822,31 @@ void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int hei
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
 		for (int x = startX; x < endX; ++x)
 		{
-			const int dest_pxl = (Y + y) * xRes + X + x;
-			const int src_pxl = int((float)y * yPxlsPerPxl) * this->width + int((float)x * xPxlsPerPxl);
+			const int src_pxl = y * width + x;
 			if (pImage[src_pxl].GetA())
 			{
-				gfx.GetPixelMap(layer)[dest_pxl] = pImage[src_pxl];
+				const int dest_pxl = (Y + y) * xRes + X + x;
+				pPixelMap[dest_pxl] = color_func(*this, x, y, src_pxl);
 			}
 		}
 	}
 }
 
-void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, std::function<Color(const Image&, int, int, int)> color_func, int layer) const
+void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int height, std::function<Color(const Image&, int, int, int)> color_func, int layer) const
 {
 	const int& xRes = gfx.GetWidth(layer);
 	const int& yRes = gfx.GetHeight(layer);
+	assert(width != 0 && height != 0);
 	assert(X < (int)xRes && X + width > 0);
 	assert(Y < (int)yRes && Y + height > 0);
+	const float xPxlsPerPxl = (float)this->width / (float)width;
+	const float yPxlsPerPxl = (float)this->height / (float)height;
 	const int startX =
 		(0) * (X >= 0) +
 		(-X) * (X < 0);
@@ -747,33 +855,40 @@ void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, std::function<Colo
 		(-Y) * (Y < 0);
 	const int endX =
 		(xRes - X) * (width + X > xRes) +
-		(width) * (height + X <= xRes);
+		(width) * (width + X <= xRes);
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
 		for (int x = startX; x < endX; ++x)
 		{
-			const int src_pxl = y * width + x;
+			const int dest_pxl = (Y + y) * xRes + X + x;
+			const int src_x = int((float)x * xPxlsPerPxl);
+			const int src_y = int((float)y * yPxlsPerPxl);
+			const int src_pxl = src_y * this->width + src_x;
 			if (pImage[src_pxl].GetA())
 			{
-				const int dest_pxl = (Y + y) * xRes + X + x;
-				gfx.GetPixelMap(layer)[dest_pxl] = color_func(*this, x, y, src_pxl);
+				pPixelMap[dest_pxl] = color_func(*this, src_x, src_y, src_pxl);
 			}
 		}
 	}
 }
 
-void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int height, std::function<Color(const Image&, int, int, int)> color_func, int layer) const
+void Image::DrawBlended(Graphics& gfx, int X, int Y, BlendMode mode, int layer) const
+{
+	DrawBlended(gfx, X, Y, mode, 1.0f, layer);
+}
+
+void Image::DrawBlended(Graphics& gfx, int X, int Y, BlendMode mode, float opacity, int layer) const
 {
 	const int& xRes = gfx.GetWidth(layer);
 	const int& yRes = gfx.GetHeight(layer);
-	assert(width != 0 && height != 0);
 	assert(X < (int)xRes && X + width > 0);
 	assert(Y < (int)yRes && Y + height > 0);
-	const float xPxlsPerPxl = (float)this->width / (float)width;
-	const float yPxlsPerPxl = (float)this->height / (float)height;
+	assert(opacity >= 0.0f && opacity <= 1.0f);
 	const int startX =
 		(0) * (X >= 0) +
 		(-X) * (X < 0);
@@ -786,19 +901,14 @@ void Image::DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int hei
 	const int endY =
 		(yRes - Y) * (height + Y > yRes) +
 		(height) * (height + Y <= yRes);
+	const unsigned char opacity8 = (unsigned char)(opacity * 255.0f + 0.5f);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
 	for (int y = startY; y < endY; ++y)
 	{
-		for (int x = startX; x < endX; ++x)
-		{
-			const int dest_pxl = (Y + y) * xRes + X + x;
-			const int src_x = int((float)x * xPxlsPerPxl);
-			const int src_y = int((float)y * yPxlsPerPxl);
-			const int src_pxl = src_y * this->width + src_x;
-			if (pImage[src_pxl].GetA())
-			{
-				gfx.GetPixelMap(layer)[dest_pxl] = color_func(*this, src_x, src_y, src_pxl);
-			}
-		}
+		const int dest_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		PixelKernels::BlendRow(&pPixelMap[dest_pxl], &pImage[src_pxl], endX - startX, mode, opacity8);
 	}
 }
 
@@ -810,7 +920,7 @@ Color ImageEffects::InvertColors(const Image& image, int img_x, int img_y, int i
 Color ImageEffects::GreyScale(const Image& image, int img_x, int img_y, int img_pxl)
 {
 	const Color& pxl = image.GetPtrToImage()[img_pxl];
-	const unsigned char scale = unsigned char(((int)pxl.GetR() + (int)pxl.GetG() + (int)pxl.GetB()) / 3);
+	const unsigned char scale = (unsigned char)(((int)pxl.GetR() + (int)pxl.GetG() + (int)pxl.GetB()) / 3);
 	return Color(scale, scale, scale, pxl.GetA());
 }
 
@@ -10,11 +10,17 @@ class Image
 private:
 	int width = 0;
 	int height = 0;
-	std::unique_ptr<Color[]> pImage = nullptr;
+	std::shared_ptr<Color[]> pImage = nullptr;
+private:
+	static std::shared_ptr<Color[]> AllocatePixels(int nPixels);
+	Color* GetMutablePtrToImage();
+	void DrawScaled(Graphics& gfx, int X, int Y, int width, int height, bool transparency, int layer) const;
 public:
 	Image() = default;
-	Image(const Image& image);
-	Image& operator =(const Image& image);
+	Image(const Image& image) = default;
+	Image& operator =(const Image& image) = default;
+	Image(Image&& image) noexcept;
+	Image& operator =(Image&& image) noexcept;
 	Image(int width, int height, Color color = Colors::White);
 	Image(const char* filename);
 	Image(const std::vector<Color>& image, int image_width);
@@ -22,10 +28,13 @@ public:
 	int GetHeight() const;
 	iRect GetRect(int x = 0, int y = 0) const;
 	const Color* GetPtrToImage() const;
+	// another owner of the pixels, which also makes later in-place edits of this image copy them first
+	std::shared_ptr<const Color[]> SharePixels() const;
 	void SetPixel(int x, int y, const Color& color);
 	const Color& GetPixel(int x, int y) const;
 	Image Cropped(int new_width, int new_height, int x_off, int y_off) const;
 	Image& Crop(int new_width, int new_height, int x_off, int y_off);
+	void Paste(const Image& image, int x_off, int y_off);
 	Image FlippedV() const;
 	Image& FlipV();
 	Image FlippedH() const;
@@ -36,8 +45,12 @@ public:
 	Image& Rotate180();
 	Image Rotated270() const;
 	Image& Rotate270();
-	Image AdjustedSize(float x_adjust, float y_adjust) const;
-	Image& AdjustSize(float x_adjust, float y_adjust);
+	Image Transposed() const;
+	Image& Transpose();
+	Image Resized(int new_width, int new_height, ResampleFilter filter = ResampleFilter::Nearest) const;
+	Image& Resize(int new_width, int new_height, ResampleFilter filter = ResampleFilter::Nearest);
+	Image AdjustedSize(float x_adjust, float y_adjust, ResampleFilter filter = ResampleFilter::Nearest) const;
+	Image& AdjustSize(float x_adjust, float y_adjust, ResampleFilter filter = ResampleFilter::Nearest);
 	Image WithAddedTransparencyFromChroma(const Color& chroma) const;
 	Image& AddTransparencyFromChroma(const Color& chroma);
 	Image WithInvertedColors() const;
@@ -54,18 +67,24 @@ public:
 	Image& MakeMosaic(int2 img_divs);
 	Image Silhouetted(const Color& background, const Color& silhouette) const;
 	Image& Silhouette(const Color& background, const Color& silhouette);
+	Image Premultiplied() const;
+	Image& Premultiply();
 	void Load(const char* filename);
 	void Save(const char* filename) const;
 	void Import(const std::vector<Color>& image, int image_width);
 	std::vector<Color> Export() const;
 	void Draw(Graphics& gfx, int X, int Y, int layer = 0) const;
 	void Draw(Graphics& gfx, int X, int Y, int width, int height, int layer = 0) const;
+	// draws only the given part of the image, which must land entirely inside the layer
+	void DrawRegion(Graphics& gfx, int X, int Y, const iRect& region, int layer = 0) const;
 	void Draw(Graphics& gfx, int X, int Y, std::function<Color(const Image&, int, int, int)> color_func, int layer = 0) const;
 	void Draw(Graphics& gfx, int X, int Y, int width, int height, std::function<Color(const Image&, int, int, int)> color_func, int layer = 0) const;
 	void DrawWithTransparency(Graphics& gfx, int X, int Y, int layer = 0) const;
 	void DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int height, int layer = 0) const;
 	void DrawWithTransparency(Graphics& gfx, int X, int Y, std::function<Color(const Image&, int, int, int)> color_func, int layer = 0) const;
 	void DrawWithTransparency(Graphics& gfx, int X, int Y, int width, int height, std::function<Color(const Image&, int, int, int)> color_func, int layer = 0) const;
+	void DrawBlended(Graphics& gfx, int X, int Y, BlendMode mode, int layer = 0) const;
+	void DrawBlended(Graphics& gfx, int X, int Y, BlendMode mode, float opacity, int layer = 0) const;
 };
 
 namespace ImageEffects
@@ -0,0 +1,45 @@
+#include "ImageDecoder.h"
+#include "BaseException.h"
+
+std::shared_ptr<Color[]> ImageDecoder::AllocatePixels(int width, int height)
+{
+	constexpr long long maxPixels = (1LL << 31) / sizeof(Color);
+	if (width <= 0 || height <= 0 || (long long)width * height >= maxPixels)
+	{
+		throw EXCPT_NOTE("Image dimensions are invalid or too large! Check the image file and retry.");
+	}
+	return std::shared_ptr<Color[]>(new Color[width * height]);
+}
+
+std::vector<std::unique_ptr<ImageDecoder>>& ImageDecoder::GetRegistry()
+{
+	static std::vector<std::unique_ptr<ImageDecoder>> registry = []()
+	{
+		std::vector<std::unique_ptr<ImageDecoder>> decoders;
+		decoders.push_back(std::make_unique<BmpDecoder>());
+		decoders.push_back(std::make_unique<QoiDecoder>());
+		decoders.push_back(std::make_unique<PngDecoder>());
+		decoders.push_back(std::make_unique<TgaDecoder>());
+		return decoders;
+	}();
+	return registry;
+}
+
+void ImageDecoder::Register(std::unique_ptr<ImageDecoder> pDecoder)
+{
+	std::vector<std::unique_ptr<ImageDecoder>>& registry = GetRegistry();
+	registry.insert(registry.begin(), std::move(pDecoder));
+}
+
+DecodedImage ImageDecoder::DecodeFile(const char* filename)
+{
+	std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>(filename);
+	for (const std::unique_ptr<ImageDecoder>& pDecoder : GetRegistry())
+	{
+		if (pDecoder->CanDecode(pFile->GetData(), pFile->GetSize()))
+		{
+			return pDecoder->Decode(pFile);
+		}
+	}
+	throw EXCPT_NOTE("Unsupported image file format! Supported formats are .bmp, .qoi, .png and .tga.");
+}
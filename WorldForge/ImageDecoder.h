@@ -0,0 +1,55 @@
+#pragma once
+#include "Color.h"
+#include "MappedFile.h"
+#include <memory>
+#include <vector>
+
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	std::shared_ptr<Color[]> pPixels = nullptr;
+};
+
+class ImageDecoder
+{
+public:
+	virtual ~ImageDecoder() = default;
+	virtual bool CanDecode(const unsigned char* pData, size_t size) const = 0;
+	virtual DecodedImage Decode(const std::shared_ptr<MappedFile>& pFile) const = 0;
+protected:
+	static std::shared_ptr<Color[]> AllocatePixels(int width, int height);
+private:
+	static std::vector<std::unique_ptr<ImageDecoder>>& GetRegistry();
+public:
+	static void Register(std::unique_ptr<ImageDecoder> pDecoder);
+	static DecodedImage DecodeFile(const char* filename);
+};
+
+class BmpDecoder : public ImageDecoder
+{
+public:
+	bool CanDecode(const unsigned char* pData, size_t size) const override;
+	DecodedImage Decode(const std::shared_ptr<MappedFile>& pFile) const override;
+};
+
+class QoiDecoder : public ImageDecoder
+{
+public:
+	bool CanDecode(const unsigned char* pData, size_t size) const override;
+	DecodedImage Decode(const std::shared_ptr<MappedFile>& pFile) const override;
+};
+
+class PngDecoder : public ImageDecoder
+{
+public:
+	bool CanDecode(const unsigned char* pData, size_t size) const override;
+	DecodedImage Decode(const std::shared_ptr<MappedFile>& pFile) const override;
+};
+
+class TgaDecoder : public ImageDecoder
+{
+public:
+	bool CanDecode(const unsigned char* pData, size_t size) const override;
+	DecodedImage Decode(const std::shared_ptr<MappedFile>& pFile) const override;
+};
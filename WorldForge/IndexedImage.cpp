@@ -0,0 +1,252 @@
+#include "IndexedImage.h"
+#include "PixelKernels.h"
+#include "BaseException.h"
+#include <unordered_map>
+#include <assert.h>
+#include <string.h>
+
+unsigned char* IndexedImage::GetMutablePtrToIndices()
+{
+	if (pIndices.use_count() > 1)
+	{
+		std::shared_ptr<unsigned char[]> pUnique(new unsigned char[width * height]);
+		memcpy(pUnique.get(), pIndices.get(), width * height);
+		pIndices = std::move(pUnique);
+	}
+	return pIndices.get();
+}
+
+IndexedImage::IndexedImage(int width, int height, const std::vector<unsigned char>& indices, const std::vector<Color>& palette)
+	:
+	width(width),
+	height(height),
+	paletteSize((int)palette.size()),
+	pIndices(new unsigned char[width * height]),
+	palette(palette)
+{
+	assert((int)indices.size() == width * height);
+	if (paletteSize > maxPaletteSize)
+	{
+		throw EXCPT_NOTE("Indexed images support at most 256 palette colors! Reduce the palette and retry.");
+	}
+	this->palette.resize(maxPaletteSize, Colors::Transparent);
+	memcpy(pIndices.get(), indices.data(), width * height);
+}
+
+IndexedImage::IndexedImage(const Image& image)
+	:
+	width(image.GetWidth()),
+	height(image.GetHeight()),
+	pIndices(new unsigned char[image.GetWidth() * image.GetHeight()]),
+	palette(maxPaletteSize, Colors::Transparent)
+{
+	std::unordered_map<unsigned int, unsigned char> colorIndices;
+	const Color* const pImage = image.GetPtrToImage();
+	unsigned int prevColor = 0;
+	unsigned char prevIndex = 0;
+	for (int i = 0; i < width * height; ++i)
+	{
+		unsigned int color;
+		memcpy(&color, &pImage[i], sizeof(color));
+		if (i > 0 && color == prevColor)
+		{
+			pIndices[i] = prevIndex;
+			continue;
+		}
+		auto entry = colorIndices.find(color);
+		if (entry == colorIndices.end())
+		{
+			if (paletteSize == maxPaletteSize)
+			{
+				throw EXCPT_NOTE("Image has more than 256 unique colors and cannot be indexed! Reduce the color count and retry.");
+			}
+			palette[paletteSize] = pImage[i];
+			entry = colorIndices.emplace(color, (unsigned char)paletteSize++).first;
+		}
+		pIndices[i] = entry->second;
+		prevColor = color;
+		prevIndex = entry->second;
+	}
+}
+
+int IndexedImage::GetWidth() const
+{
+	return width;
+}
+
+int IndexedImage::GetHeight() const
+{
+	return height;
+}
+
+iRect IndexedImage::GetRect(int x, int y) const
+{
+	return iRect(vec2i(x, y), width, height);
+}
+
+const unsigned char* IndexedImage::GetPtrToIndices() const
+{
+	return pIndices.get();
+}
+
+int IndexedImage::GetPaletteSize() const
+{
+	return paletteSize;
+}
+
+std::vector<Color> IndexedImage::GetPalette() const
+{
+	return std::vector<Color>(palette.begin(), palette.begin() + paletteSize);
+}
+
+void IndexedImage::SetPalette(const std::vector<Color>& new_palette)
+{
+	if ((int)new_palette.size() > maxPaletteSize)
+	{
+		throw EXCPT_NOTE("Indexed images support at most 256 palette colors! Reduce the palette and retry.");
+	}
+	paletteSize = (int)new_palette.size();
+	std::copy(new_palette.begin(), new_palette.end(), palette.begin());
+	std::fill(palette.begin() + paletteSize, palette.end(), Colors::Transparent);
+}
+
+const Color& IndexedImage::GetPaletteColor(int index) const
+{
+	assert(index >= 0 && index < paletteSize);
+	return palette[index];
+}
+
+void IndexedImage::SetPaletteColor(int index, const Color& color)
+{
+	assert(index >= 0 && index < paletteSize);
+	palette[index] = color;
+}
+
+unsigned char IndexedImage::GetIndex(int x, int y) const
+{
+	assert(x < width && y < height);
+	return pIndices[y * width + x];
+}
+
+void IndexedImage::SetIndex(int x, int y, unsigned char index)
+{
+	assert(x < width && y < height);
+	assert(index < paletteSize);
+	GetMutablePtrToIndices()[y * width + x] = index;
+}
+
+const Color& IndexedImage::GetPixel(int x, int y) const
+{
+	return palette[GetIndex(x, y)];
+}
+
+IndexedImage IndexedImage::WithSubstitutedColors(std::vector<Color> targets, std::vector<Color> replacements) const
+{
+	IndexedImage substituted{ *this };
+	substituted.SubstituteColors(std::move(targets), std::move(replacements));
+	return substituted;
+}
+
+IndexedImage& IndexedImage::SubstituteColors(std::vector<Color> targets, std::vector<Color> replacements)
+{
+	assert(targets.size() <= replacements.size());
+	std::vector<unsigned int> keys;
+	std::vector<Color> values;
+	PixelKernels::BuildRemapTable(targets, replacements, keys, values);
+	PixelKernels::RemapRow(palette.data(), palette.data(), paletteSize, keys.data(), values.data(), (int)keys.size());
+	return *this;
+}
+
+Image IndexedImage::ToImage() const
+{
+	std::vector<Color> pixels(width * height);
+	PixelKernels::ExpandIndexedRow(pixels.data(), pIndices.get(), palette.data(), width * height);
+	return Image(pixels, width);
+}
+
+void IndexedImage::Draw(Graphics& gfx, int X, int Y, int layer) const
+{
+	const int& xRes = gfx.GetWidth(layer);
+	const int& yRes = gfx.GetHeight(layer);
+	assert(X < (int)xRes && X + width > 0);
+	assert(Y < (int)yRes && Y + height > 0);
+	const int startX =
+		(0) * (X >= 0) +
+		(-X) * (X < 0);
+	const int startY =
+		(0) * (Y >= 0) +
+		(-Y) * (Y < 0);
+	const int endX =
+		(xRes - X) * (width + X > xRes) +
+		(width) * (width + X <= xRes);
+	const int endY =
+		(yRes - Y) * (height + Y > yRes) +
+		(height) * (height + Y <= yRes);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	for (int y = startY; y < endY; ++y)
+	{
+		const int dst_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		PixelKernels::ExpandIndexedRow(&pPixelMap[dst_pxl], &pIndices[src_pxl], palette.data(), endX - startX);
+	}
+}
+
+void IndexedImage::DrawWithTransparency(Graphics& gfx, int X, int Y, int layer) const
+{
+	const int& xRes = gfx.GetWidth(layer);
+	const int& yRes = gfx.GetHeight(layer);
+	assert(X < (int)xRes && X + width > 0);
+	assert(Y < (int)yRes && Y + height > 0);
+	const int startX =
+		(0) * (X >= 0) +
+		(-X) * (X < 0);
+	const int startY =
+		(0) * (Y >= 0) +
+		(-Y) * (Y < 0);
+	const int endX =
+		(xRes - X) * (width + X > xRes) +
+		(width) * (width + X <= xRes);
+	const int endY =
+		(yRes - Y) * (height + Y > yRes) +
+		(height) * (height + Y <= yRes);
+	thread_local std::vector<Color> rowBuffer;
+	rowBuffer.resize(endX - startX);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
+	Color* const pPixelMap = gfx.GetPixelMap(layer).data();
+	for (int y = startY; y < endY; ++y)
+	{
+		const int dst_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		PixelKernels::ExpandIndexedRow(rowBuffer.data(), &pIndices[src_pxl], palette.data(), endX - startX);
+		PixelKernels::CopyRowWithTransparency(&pPixelMap[dst_pxl], rowBuffer.data(), endX - startX);
+	}
+}
+
+void IndexedImage::DrawIndices(Graphics& gfx, int X, int Y, int layer) const
+{
+	const int& xRes = gfx.GetWidth(layer);
+	const int& yRes = gfx.GetHeight(layer);
+	assert(X < (int)xRes && X + width > 0);
+	assert(Y < (int)yRes && Y + height > 0);
+	const int startX =
+		(0) * (X >= 0) +
+		(-X) * (X < 0);
+	const int startY =
+		(0) * (Y >= 0) +
+		(-Y) * (Y < 0);
+	const int endX =
+		(xRes - X) * (width + X > xRes) +
+		(width) * (width + X <= xRes);
+	const int endY =
+		(yRes - Y) * (height + Y > yRes) +
+		(height) * (height + Y <= yRes);
+	gfx.MarkDirty(iRect({ X + startX,Y + startY }, endX - startX, endY - startY), layer);
+	unsigned char* const pIndexMap = gfx.GetIndexMap(layer).data();
+	for (int y = startY; y < endY; ++y)
+	{
+		const int dst_pxl = (Y + y) * xRes + X + startX;
+		const int src_pxl = y * width + startX;
+		memcpy(&pIndexMap[dst_pxl], &pIndices[src_pxl], endX - startX);
+	}
+}
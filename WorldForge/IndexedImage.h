@@ -0,0 +1,39 @@
+#pragma once
+#include "Image.h"
+
+class IndexedImage
+{
+private:
+	static constexpr int maxPaletteSize = 256;
+private:
+	int width = 0;
+	int height = 0;
+	int paletteSize = 0;
+	std::shared_ptr<unsigned char[]> pIndices = nullptr;
+	std::vector<Color> palette;
+private:
+	unsigned char* GetMutablePtrToIndices();
+public:
+	IndexedImage() = default;
+	IndexedImage(int width, int height, const std::vector<unsigned char>& indices, const std::vector<Color>& palette);
+	IndexedImage(const Image& image);
+	int GetWidth() const;
+	int GetHeight() const;
+	iRect GetRect(int x = 0, int y = 0) const;
+	const unsigned char* GetPtrToIndices() const;
+	int GetPaletteSize() const;
+	std::vector<Color> GetPalette() const;
+	void SetPalette(const std::vector<Color>& new_palette);
+	const Color& GetPaletteColor(int index) const;
+	void SetPaletteColor(int index, const Color& color);
+	unsigned char GetIndex(int x, int y) const;
+	void SetIndex(int x, int y, unsigned char index);
+	const Color& GetPixel(int x, int y) const;
+	IndexedImage WithSubstitutedColors(std::vector<Color> targets, std::vector<Color> replacements) const;
+	IndexedImage& SubstituteColors(std::vector<Color> targets, std::vector<Color> replacements);
+	Image ToImage() const;
+	void Draw(Graphics& gfx, int X, int Y, int layer = 0) const;
+	void DrawWithTransparency(Graphics& gfx, int X, int Y, int layer = 0) const;
+	// writes raw indices into an Indexed8 layer, which is expected to share this image's palette
+	void DrawIndices(Graphics& gfx, int X, int Y, int layer = 0) const;
+};
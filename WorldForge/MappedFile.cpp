@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+#include "BaseException.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* filename)
+{
+#ifdef _WIN32
+	hFile = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		throw EXCPT_NOTE("File not found! Check directory and/or file name spelling and retry.");
+	}
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		throw EXCPT_NOTE("File is empty or unreadable! Check the file and retry.");
+	}
+	size = (size_t)fileSize.QuadPart;
+	hMapping = CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (hMapping != nullptr)
+	{
+		pData = static_cast<unsigned char*>(MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0));
+	}
+	if (pData == nullptr)
+	{
+		if (hMapping != nullptr)
+		{
+			CloseHandle(hMapping);
+		}
+		CloseHandle(hFile);
+		throw EXCPT_NOTE("File could not be mapped into memory! Please retry.");
+	}
+#else
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		throw EXCPT_NOTE("File not found! Check directory and/or file name spelling and retry.");
+	}
+	struct stat fileStat = {};
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		throw EXCPT_NOTE("File is empty or unreadable! Check the file and retry.");
+	}
+	size = (size_t)fileStat.st_size;
+	void* pMapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMapping == MAP_FAILED)
+	{
+		throw EXCPT_NOTE("File could not be mapped into memory! Please retry.");
+	}
+	madvise(pMapping, size, MADV_SEQUENTIAL);
+	pData = static_cast<unsigned char*>(pMapping);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	UnmapViewOfFile(pData);
+	CloseHandle(hMapping);
+	CloseHandle(hFile);
+#else
+	munmap(pData, size);
+#endif
+}
+
+unsigned char* MappedFile::GetData() const
+{
+	return pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+#ifdef _WIN32
+#include "Win32Includes.h"
+#endif
+
+class MappedFile
+{
+private:
+#ifdef _WIN32
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	HANDLE hMapping = nullptr;
+#endif
+	unsigned char* pData = nullptr;
+	size_t size = 0;
+public:
+	MappedFile() = delete;
+	MappedFile(const MappedFile& file) = delete;
+	MappedFile& operator =(const MappedFile& file) = delete;
+	MappedFile(const char* filename);
+	~MappedFile();
+	unsigned char* GetData() const;
+	size_t GetSize() const;
+};
@@ -0,0 +1,782 @@
+#include "PixelKernels.h"
+#include "WorkerPool.h"
+#include <string.h>
+#include <algorithm>
+#include <stddef.h>
+#include <math.h>
+#include <vector>
+#include <assert.h>
+
+#if defined(__AVX2__)
+#define SIMD_AVX2
+#endif
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SIMD_SSE2
+#endif
+
+#if defined(SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+void PixelKernels::CopyRow(Color* dst, const Color* src, int count)
+{
+	memcpy(dst, src, count * sizeof(Color));
+}
+
+void PixelKernels::CopyRowWithTransparency(Color* dst, const Color* src, int count)
+{
+	int i = 0;
+#if defined(SIMD_AVX2)
+	const __m256i alphaMask8 = _mm256_set1_epi32(0xFF000000);
+	const __m256i zero8 = _mm256_setzero_si256();
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+		const __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(s, alphaMask8), zero8);
+		const int mask = _mm256_movemask_epi8(transparent);
+		if (mask == -1)
+		{
+			continue;
+		}
+		if (mask == 0)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[i]), s);
+			continue;
+		}
+		const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&dst[i]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[i]), _mm256_blendv_epi8(s, d, transparent));
+	}
+#endif
+#if defined(SIMD_SSE2)
+	const __m128i alphaMask4 = _mm_set1_epi32(0xFF000000);
+	const __m128i zero4 = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+		const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, alphaMask4), zero4);
+		const int mask = _mm_movemask_epi8(transparent);
+		if (mask == 0xFFFF)
+		{
+			continue;
+		}
+		if (mask == 0)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), s);
+			continue;
+		}
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&dst[i]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s)));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		if (src[i].GetA())
+		{
+			dst[i] = src[i];
+		}
+	}
+}
+
+void PixelKernels::ExpandBGRRow(Color* dst, const unsigned char* src, int count)
+{
+	int i = 0;
+#if defined(SIMD_AVX2)
+	const __m128i bgrToBgra = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i opaque = _mm_set1_epi32(0xFF000000);
+	for (; i + 6 <= count; i += 4)
+	{
+		const __m128i bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i * 3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_or_si128(_mm_shuffle_epi8(bgr, bgrToBgra), opaque));
+	}
+#elif defined(SIMD_SSE2)
+	// without a byte shuffle, pixel k's three bytes are shifted up k bytes into their own lane
+	const __m128i lane0 = _mm_setr_epi32(0x00FFFFFF, 0, 0, 0);
+	const __m128i lane1 = _mm_setr_epi32(0, 0x00FFFFFF, 0, 0);
+	const __m128i lane2 = _mm_setr_epi32(0, 0, 0x00FFFFFF, 0);
+	const __m128i lane3 = _mm_setr_epi32(0, 0, 0, 0x00FFFFFF);
+	const __m128i opaque = _mm_set1_epi32(0xFF000000);
+	for (; i + 6 <= count; i += 4)
+	{
+		const __m128i bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i * 3]));
+		const __m128i bgra = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(bgr, lane0), _mm_and_si128(_mm_slli_si128(bgr, 1), lane1)),
+			_mm_or_si128(_mm_and_si128(_mm_slli_si128(bgr, 2), lane2), _mm_and_si128(_mm_slli_si128(bgr, 3), lane3)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_or_si128(bgra, opaque));
+	}
+#endif
+	for (; i + 1 < count; ++i)
+	{
+		unsigned int bgra;
+		memcpy(&bgra, &src[i * 3], sizeof(bgra));
+		bgra |= 0xFF000000;
+		memcpy(static_cast<void*>(&dst[i]), &bgra, sizeof(bgra));
+	}
+	for (; i < count; ++i)
+	{
+		dst[i] = Color(src[i * 3 + 2], src[i * 3 + 1], src[i * 3], (unsigned char)255);
+	}
+}
+
+void PixelKernels::GatherRow(Color* dst, const Color* src, const int* srcIndices, int count)
+{
+	int i = 0;
+#if defined(SIMD_AVX2)
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&srcIndices[i]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[i]), _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), indices, sizeof(Color)));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i] = src[srcIndices[i]];
+	}
+}
+
+int PixelKernels::NearestIndex(int dstIndex, int dstSize, int srcSize)
+{
+	assert(dstSize > 0);
+	return (int)((long long)dstIndex * srcSize / dstSize);
+}
+
+void PixelKernels::NearestIndices(int* srcIndices, int first, int count, int dstSize, int srcSize)
+{
+	assert(dstSize > 0);
+	// steps the quotient and remainder of first * srcSize / dstSize, so every index matches NearestIndex exactly
+	const int whole = srcSize / dstSize;
+	const int fraction = srcSize % dstSize;
+	int index = NearestIndex(first, dstSize, srcSize);
+	int error = (int)((long long)first * srcSize % dstSize);
+	for (int i = 0; i < count; ++i)
+	{
+		srcIndices[i] = index;
+		index += whole;
+		error += fraction;
+		if (error >= dstSize)
+		{
+			error -= dstSize;
+			++index;
+		}
+	}
+}
+
+void PixelKernels::ExpandIndexedRow(Color* dst, const unsigned char* indices, const Color* palette, int count)
+{
+	int i = 0;
+#if defined(SIMD_AVX2)
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&indices[i])));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[i]), _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), idx, sizeof(Color)));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i] = palette[indices[i]];
+	}
+}
+
+void PixelKernels::ExpandRGB565Row(Color* dst, const unsigned short* src, int count)
+{
+	int i = 0;
+#if defined(SIMD_SSE2)
+	// channels are widened with bit replication so that 0x1F/0x3F map to exactly 0xFF
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mask6 = _mm_set1_epi16(0x3F);
+	const __m128i opaque = _mm_set1_epi16((short)0xFF00);
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+		const __m128i b5 = _mm_and_si128(packed, mask5);
+		const __m128i g6 = _mm_and_si128(_mm_srli_epi16(packed, 5), mask6);
+		const __m128i r5 = _mm_srli_epi16(packed, 11);
+		const __m128i b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+		const __m128i g = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+		const __m128i r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+		const __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+		const __m128i ra = _mm_or_si128(r, opaque);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_unpacklo_epi16(bg, ra));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i + 4]), _mm_unpackhi_epi16(bg, ra));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		const unsigned int packed = src[i];
+		const unsigned int r5 = packed >> 11;
+		const unsigned int g6 = (packed >> 5) & 0x3F;
+		const unsigned int b5 = packed & 0x1F;
+		dst[i] = Color((unsigned char)((r5 << 3) | (r5 >> 2)), (unsigned char)((g6 << 2) | (g6 >> 4)), (unsigned char)((b5 << 3) | (b5 >> 2)), (unsigned char)255);
+	}
+}
+
+void PixelKernels::PackRGB565Row(unsigned short* dst, const Color* src, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		dst[i] = (unsigned short)(((src[i].GetR() >> 3) << 11) | ((src[i].GetG() >> 2) << 5) | (src[i].GetB() >> 3));
+	}
+}
+
+void PixelKernels::BuildRemapTable(const std::vector<Color>& targets, const std::vector<Color>& replacements, std::vector<unsigned int>& sortedKeys, std::vector<Color>& values)
+{
+	const int nTargets = (int)std::min(targets.size(), replacements.size());
+	std::vector<std::pair<unsigned int, int>> entries(nTargets);
+	for (int i = 0; i < nTargets; ++i)
+	{
+		entries[i] = { targets[i].GetB() | (targets[i].GetG() << 8) | (targets[i].GetR() << 16), i };
+	}
+	std::sort(entries.begin(), entries.end());
+	sortedKeys.clear();
+	values.clear();
+	for (const std::pair<unsigned int, int>& entry : entries)
+	{
+		if (sortedKeys.empty() || sortedKeys.back() != entry.first)
+		{
+			sortedKeys.push_back(entry.first);
+			values.push_back(replacements[entry.second]);
+		}
+	}
+}
+
+void PixelKernels::RemapRow(Color* dst, const Color* src, int count, const unsigned int* sortedKeys, const Color* values, int nEntries)
+{
+	int i = 0;
+#if defined(SIMD_SSE2)
+	constexpr int maxVectorEntries = 8;
+	if (nEntries <= maxVectorEntries)
+	{
+		__m128i keys[maxVectorEntries];
+		__m128i replacements[maxVectorEntries];
+		for (int e = 0; e < nEntries; ++e)
+		{
+			int value;
+			memcpy(&value, &values[e], sizeof(value));
+			keys[e] = _mm_set1_epi32((int)sortedKeys[e]);
+			replacements[e] = _mm_set1_epi32(value);
+		}
+		const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+			const __m128i rgb = _mm_and_si128(s, rgbMask);
+			__m128i out = s;
+			for (int e = 0; e < nEntries; ++e)
+			{
+				const __m128i match = _mm_cmpeq_epi32(rgb, keys[e]);
+				out = _mm_or_si128(_mm_and_si128(match, replacements[e]), _mm_andnot_si128(match, out));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), out);
+		}
+	}
+#endif
+	const unsigned int* const pKeysEnd = sortedKeys + nEntries;
+	unsigned int cachedKey = 0xFFFFFFFF;
+	const Color* pCachedValue = nullptr;
+	for (; i < count; ++i)
+	{
+		const unsigned int key = src[i].GetB() | (src[i].GetG() << 8) | (src[i].GetR() << 16);
+		if (key != cachedKey)
+		{
+			const unsigned int* const pKey = std::lower_bound(sortedKeys, pKeysEnd, key);
+			pCachedValue = (pKey != pKeysEnd && *pKey == key) ? &values[pKey - sortedKeys] : nullptr;
+			cachedKey = key;
+		}
+		dst[i] = pCachedValue ? *pCachedValue : src[i];
+	}
+}
+
+static inline int Div255(int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline Color BlendPixel(const Color& d, const Color& s, BlendMode mode, int opacity)
+{
+	const int a = Div255((int)s.GetA() * opacity);
+	const int invA = 255 - a;
+	const int src[3] = { s.GetB(),s.GetG(),s.GetR() };
+	const int dst[3] = { d.GetB(),d.GetG(),d.GetR() };
+	int out[3] = {};
+	for (int c = 0; c < 3; ++c)
+	{
+		switch (mode)
+		{
+		case BlendMode::SourceOver:
+			out[c] = Div255(src[c] * a + dst[c] * invA);
+			break;
+		case BlendMode::PremultipliedSourceOver:
+			out[c] = std::min(255, Div255(src[c] * opacity) + Div255(dst[c] * invA));
+			break;
+		case BlendMode::Additive:
+			out[c] = std::min(255, dst[c] + Div255(src[c] * a));
+			break;
+		case BlendMode::Multiply:
+			out[c] = Div255(Div255(src[c] * dst[c]) * a + dst[c] * invA);
+			break;
+		case BlendMode::Screen:
+			out[c] = Div255((src[c] + dst[c] - Div255(src[c] * dst[c])) * a + dst[c] * invA);
+			break;
+		}
+	}
+	return Color(out[2], out[1], out[0], a + Div255((int)d.GetA() * invA));
+}
+
+#if defined(SIMD_SSE2)
+static inline __m128i Div255_epi16(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static inline __m128i BlendPixels_epi16(__m128i d, __m128i s, BlendMode mode, __m128i opacity)
+{
+	const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	const __m128i all255 = _mm_set1_epi16(255);
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	a = Div255_epi16(_mm_mullo_epi16(a, opacity));
+	const __m128i invA = _mm_sub_epi16(all255, a);
+	const __m128i dInvA = Div255_epi16(_mm_mullo_epi16(d, invA));
+	__m128i out;
+	switch (mode)
+	{
+	case BlendMode::SourceOver:
+		out = Div255_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, invA)));
+		break;
+	case BlendMode::PremultipliedSourceOver:
+		out = _mm_min_epi16(all255, _mm_add_epi16(Div255_epi16(_mm_mullo_epi16(s, opacity)), dInvA));
+		break;
+	case BlendMode::Additive:
+		out = _mm_min_epi16(all255, _mm_add_epi16(d, Div255_epi16(_mm_mullo_epi16(s, a))));
+		break;
+	case BlendMode::Multiply:
+	{
+		const __m128i b = Div255_epi16(_mm_mullo_epi16(s, d));
+		out = Div255_epi16(_mm_add_epi16(_mm_mullo_epi16(b, a), _mm_mullo_epi16(d, invA)));
+		break;
+	}
+	default:
+	{
+		const __m128i b = _mm_sub_epi16(_mm_add_epi16(s, d), Div255_epi16(_mm_mullo_epi16(s, d)));
+		out = Div255_epi16(_mm_add_epi16(_mm_mullo_epi16(b, a), _mm_mullo_epi16(d, invA)));
+		break;
+	}
+	}
+	const __m128i outA = _mm_add_epi16(a, dInvA);
+	return _mm_or_si128(_mm_andnot_si128(alphaLanes, out), _mm_and_si128(alphaLanes, outA));
+}
+#endif
+
+void PixelKernels::BlendRow(Color* dst, const Color* src, int count, BlendMode mode, unsigned char opacity)
+{
+	int i = 0;
+#if defined(SIMD_SSE2)
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i opacity16 = _mm_set1_epi16(opacity);
+	const bool canSkipTransparent = mode != BlendMode::PremultipliedSourceOver;
+	const bool canCopyOpaque = mode == BlendMode::SourceOver && opacity == 255;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+		const __m128i alpha = _mm_and_si128(s, alphaMask);
+		if (canSkipTransparent && _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF)
+		{
+			continue;
+		}
+		if (canCopyOpaque && _mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xFFFF)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), s);
+			continue;
+		}
+		const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&dst[i]));
+		const __m128i lo = BlendPixels_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), mode, opacity16);
+		const __m128i hi = BlendPixels_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), mode, opacity16);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i] = BlendPixel(dst[i], src[i], mode, opacity);
+	}
+}
+
+void PixelKernels::PremultiplyRow(Color* dst, const Color* src, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		const int a = src[i].GetA();
+		dst[i] = Color(Div255(src[i].GetR() * a), Div255(src[i].GetG() * a), Div255(src[i].GetB() * a), a);
+	}
+}
+
+#if defined(SIMD_SSE2)
+static inline void Transpose4x4(Color* dst, int dstPitch, const Color* src, int srcPitch)
+{
+	const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + srcPitch));
+	const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * srcPitch));
+	const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * srcPitch));
+	const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + dstPitch), _mm_unpackhi_epi64(t0, t1));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * dstPitch), _mm_unpacklo_epi64(t2, t3));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * dstPitch), _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+void PixelKernels::Transpose(Color* dst, int dstPitch, const Color* src, int srcPitch, int width, int height)
+{
+	constexpr int tileSize = 16;
+	for (int ty = 0; ty < height; ty += tileSize)
+	{
+		const int tileH = std::min(tileSize, height - ty);
+		for (int tx = 0; tx < width; tx += tileSize)
+		{
+			const int tileW = std::min(tileSize, width - tx);
+			const Color* const pSrcTile = src + (ptrdiff_t)ty * srcPitch + tx;
+			Color* const pDstTile = dst + (ptrdiff_t)tx * dstPitch + ty;
+			int y = 0;
+#if defined(SIMD_SSE2)
+			for (; y + 4 <= tileH; y += 4)
+			{
+				int x = 0;
+				for (; x + 4 <= tileW; x += 4)
+				{
+					Transpose4x4(pDstTile + (ptrdiff_t)x * dstPitch + y, dstPitch, pSrcTile + (ptrdiff_t)y * srcPitch + x, srcPitch);
+				}
+				for (; x < tileW; ++x)
+				{
+					for (int k = 0; k < 4; ++k)
+					{
+						pDstTile[(ptrdiff_t)x * dstPitch + y + k] = pSrcTile[(ptrdiff_t)(y + k) * srcPitch + x];
+					}
+				}
+			}
+#endif
+			for (; y < tileH; ++y)
+			{
+				for (int x = 0; x < tileW; ++x)
+				{
+					pDstTile[(ptrdiff_t)x * dstPitch + y] = pSrcTile[(ptrdiff_t)y * srcPitch + x];
+				}
+			}
+		}
+	}
+}
+
+template <typename RowFunc>
+static void ForEachRowBand(int nRows, int rowWidth, RowFunc func)
+{
+	constexpr long long minPixelsPerBand = 128 * 128;
+	const long long nPixels = (long long)nRows * rowWidth;
+	WorkerPool& pool = WorkerPool::Shared();
+	const int nBands = (int)std::min<long long>({ (long long)pool.GetThreadCount(), nPixels / minPixelsPerBand, (long long)nRows });
+	if (nBands <= 1)
+	{
+		func(0, nRows);
+		return;
+	}
+	pool.ParallelFor(nBands, [&](int band)
+	{
+		func(band * nRows / nBands, (band + 1) * nRows / nBands);
+	});
+}
+
+static void ResampleNearest(Color* dst, int dstWidth, int dstHeight, const Color* src, int srcWidth, int srcHeight)
+{
+	std::vector<int> srcX(dstWidth);
+	PixelKernels::NearestIndices(srcX.data(), 0, dstWidth, dstWidth, srcWidth);
+	ForEachRowBand(dstHeight, dstWidth, [&](int beginY, int endY)
+	{
+		int prevSrcY = -1;
+		for (int y = beginY; y < endY; ++y)
+		{
+			const int srcY = PixelKernels::NearestIndex(y, dstHeight, srcHeight);
+			Color* const pDstRow = &dst[(ptrdiff_t)y * dstWidth];
+			if (srcY == prevSrcY)
+			{
+				memcpy(pDstRow, pDstRow - dstWidth, dstWidth * sizeof(Color));
+				continue;
+			}
+			const Color* const pSrcRow = &src[(ptrdiff_t)srcY * srcWidth];
+			for (int x = 0; x < dstWidth; ++x)
+			{
+				pDstRow[x] = pSrcRow[srcX[x]];
+			}
+			prevSrcY = srcY;
+		}
+	});
+}
+
+static constexpr int weightBits = 14;
+
+struct ResampleTaps
+{
+	int maxTaps = 0;
+	std::vector<int> first;
+	std::vector<int> count;
+	std::vector<short> weights;
+};
+
+static double FilterSupport(ResampleFilter filter)
+{
+	switch (filter)
+	{
+	case ResampleFilter::Box:
+		return 0.5;
+	case ResampleFilter::Lanczos3:
+		return 3.0;
+	default:
+		return 1.0;
+	}
+}
+
+static double FilterWeight(ResampleFilter filter, double x)
+{
+	constexpr double pi = 3.14159265358979323846;
+	switch (filter)
+	{
+	case ResampleFilter::Box:
+		return (x > -0.5 && x <= 0.5) ? 1.0 : 0.0;
+	case ResampleFilter::Lanczos3:
+	{
+		if (x == 0.0)
+		{
+			return 1.0;
+		}
+		if (x <= -3.0 || x >= 3.0)
+		{
+			return 0.0;
+		}
+		const double px = pi * x;
+		return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+	}
+	default:
+		x = fabs(x);
+		return (x < 1.0) ? 1.0 - x : 0.0;
+	}
+}
+
+static ResampleTaps ComputeTaps(int srcSize, int dstSize, ResampleFilter filter)
+{
+	const double scale = (double)srcSize / dstSize;
+	const double filterScale = std::max(scale, 1.0);
+	const double support = FilterSupport(filter) * filterScale;
+	ResampleTaps taps;
+	taps.maxTaps = (int)ceil(support) * 2 + 1;
+	taps.first.resize(dstSize);
+	taps.count.resize(dstSize);
+	taps.weights.resize((size_t)dstSize * taps.maxTaps);
+	std::vector<double> w(taps.maxTaps);
+	for (int i = 0; i < dstSize; ++i)
+	{
+		const double center = (i + 0.5) * scale;
+		const int first = std::min(srcSize - 1, std::max(0, (int)(center - support + 0.5)));
+		const int last = std::max(first + 1, std::min(srcSize, (int)(center + support + 0.5)));
+		const int count = std::min(last - first, taps.maxTaps);
+		double sum = 0.0;
+		for (int k = 0; k < count; ++k)
+		{
+			w[k] = FilterWeight(filter, (first + k - center + 0.5) / filterScale);
+			sum += w[k];
+		}
+		short* const pWeights = &taps.weights[(size_t)i * taps.maxTaps];
+		int fixedSum = 0;
+		int largest = 0;
+		for (int k = 0; k < count; ++k)
+		{
+			pWeights[k] = (short)lround((sum != 0.0 ? w[k] / sum : 0.0) * (1 << weightBits));
+			fixedSum += pWeights[k];
+			largest = (pWeights[k] > pWeights[largest]) ? k : largest;
+		}
+		pWeights[largest] += (short)((1 << weightBits) - fixedSum);
+		taps.first[i] = first;
+		taps.count[i] = count;
+	}
+	return taps;
+}
+
+static inline Color PackAccumulator(int b, int g, int r, int a)
+{
+	constexpr int round = 1 << (weightBits - 1);
+	return Color(
+		std::clamp((r + round) >> weightBits, 0, 255),
+		std::clamp((g + round) >> weightBits, 0, 255),
+		std::clamp((b + round) >> weightBits, 0, 255),
+		std::clamp((a + round) >> weightBits, 0, 255));
+}
+
+#if defined(SIMD_SSE2)
+static inline __m128i LoadPixel(const Color& pixel)
+{
+	int bits;
+	memcpy(&bits, &pixel, sizeof(bits));
+	return _mm_cvtsi32_si128(bits);
+}
+
+static inline __m128i PackAccumulator_epi32(__m128i acc)
+{
+	acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (weightBits - 1))), weightBits);
+	acc = _mm_packs_epi32(acc, acc);
+	return _mm_packus_epi16(acc, acc);
+}
+
+static inline __m128i WeightPair(short w0, short w1)
+{
+	return _mm_set1_epi32((int)(unsigned short)w0 | ((int)(unsigned short)w1 << 16));
+}
+#endif
+
+static void ResampleRowH(Color* dst, const Color* src, const ResampleTaps& taps, int dstWidth)
+{
+	for (int x = 0; x < dstWidth; ++x)
+	{
+		const Color* const pSrc = &src[taps.first[x]];
+		const short* const pWeights = &taps.weights[(size_t)x * taps.maxTaps];
+		const int count = taps.count[x];
+		int k = 0;
+#if defined(SIMD_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc = _mm_setzero_si128();
+		for (; k + 2 <= count; k += 2)
+		{
+			const __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&pSrc[k])), zero);
+			const __m128i interleaved = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(interleaved, WeightPair(pWeights[k], pWeights[k + 1])));
+		}
+		if (k < count)
+		{
+			const __m128i px = _mm_unpacklo_epi16(_mm_unpacklo_epi8(LoadPixel(pSrc[k]), zero), zero);
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(px, WeightPair(pWeights[k], 0)));
+		}
+		const int packed = _mm_cvtsi128_si32(PackAccumulator_epi32(acc));
+		memcpy(static_cast<void*>(&dst[x]), &packed, sizeof(Color));
+#else
+		int b = 0, g = 0, r = 0, a = 0;
+		for (; k < count; ++k)
+		{
+			b += pSrc[k].GetB() * pWeights[k];
+			g += pSrc[k].GetG() * pWeights[k];
+			r += pSrc[k].GetR() * pWeights[k];
+			a += pSrc[k].GetA() * pWeights[k];
+		}
+		dst[x] = PackAccumulator(b, g, r, a);
+#endif
+	}
+}
+
+static void ResampleRowV(Color* dst, const Color* src, int srcPitch, const short* pWeights, int count, int width)
+{
+	int x = 0;
+#if defined(SIMD_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; x + 2 <= width; x += 2)
+	{
+		__m128i accLo = _mm_setzero_si128();
+		__m128i accHi = _mm_setzero_si128();
+		int k = 0;
+		for (; k + 2 <= count; k += 2)
+		{
+			const __m128i row0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[(ptrdiff_t)k * srcPitch + x]));
+			const __m128i row1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[(ptrdiff_t)(k + 1) * srcPitch + x]));
+			const __m128i interleaved = _mm_unpacklo_epi8(row0, row1);
+			const __m128i w = WeightPair(pWeights[k], pWeights[k + 1]);
+			accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi8(interleaved, zero), w));
+			accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi8(interleaved, zero), w));
+		}
+		if (k < count)
+		{
+			const __m128i row0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[(ptrdiff_t)k * srcPitch + x]));
+			const __m128i interleaved = _mm_unpacklo_epi8(row0, zero);
+			const __m128i w = WeightPair(pWeights[k], 0);
+			accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi8(interleaved, zero), w));
+			accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi8(interleaved, zero), w));
+		}
+		const __m128i round = _mm_set1_epi32(1 << (weightBits - 1));
+		accLo = _mm_srai_epi32(_mm_add_epi32(accLo, round), weightBits);
+		accHi = _mm_srai_epi32(_mm_add_epi32(accHi, round), weightBits);
+		const __m128i packed = _mm_packs_epi32(accLo, accHi);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(&dst[x]), _mm_packus_epi16(packed, packed));
+	}
+#endif
+	for (; x < width; ++x)
+	{
+		int b = 0, g = 0, r = 0, a = 0;
+		for (int k = 0; k < count; ++k)
+		{
+			const Color& pixel = src[(ptrdiff_t)k * srcPitch + x];
+			b += pixel.GetB() * pWeights[k];
+			g += pixel.GetG() * pWeights[k];
+			r += pixel.GetR() * pWeights[k];
+			a += pixel.GetA() * pWeights[k];
+		}
+		dst[x] = PackAccumulator(b, g, r, a);
+	}
+}
+
+static void UnpremultiplyRow(Color* row, int count)
+{
+	static const std::vector<int> reciprocals = []()
+	{
+		std::vector<int> table(256, 0);
+		for (int a = 1; a < 256; ++a)
+		{
+			table[a] = (255 << 16) / a;
+		}
+		return table;
+	}();
+	for (int i = 0; i < count; ++i)
+	{
+		const int a = row[i].GetA();
+		if (a == 255)
+		{
+			continue;
+		}
+		const int inv = reciprocals[a];
+		row[i] = Color(
+			std::min(255, (row[i].GetR() * inv + 0x8000) >> 16),
+			std::min(255, (row[i].GetG() * inv + 0x8000) >> 16),
+			std::min(255, (row[i].GetB() * inv + 0x8000) >> 16),
+			a);
+	}
+}
+
+void PixelKernels::Resample(Color* dst, int dstWidth, int dstHeight, const Color* src, int srcWidth, int srcHeight, ResampleFilter filter)
+{
+	if (dstWidth <= 0 || dstHeight <= 0 || srcWidth <= 0 || srcHeight <= 0)
+	{
+		return;
+	}
+	if (filter == ResampleFilter::Nearest)
+	{
+		ResampleNearest(dst, dstWidth, dstHeight, src, srcWidth, srcHeight);
+		return;
+	}
+	const ResampleTaps tapsX = ComputeTaps(srcWidth, dstWidth, filter);
+	const ResampleTaps tapsY = ComputeTaps(srcHeight, dstHeight, filter);
+	std::vector<Color> intermediate((size_t)dstWidth * srcHeight);
+	ForEachRowBand(srcHeight, srcWidth, [&](int beginY, int endY)
+	{
+		std::vector<Color> premultiplied(srcWidth);
+		for (int y = beginY; y < endY; ++y)
+		{
+			PixelKernels::PremultiplyRow(premultiplied.data(), &src[(ptrdiff_t)y * srcWidth], srcWidth);
+			ResampleRowH(&intermediate[(size_t)y * dstWidth], premultiplied.data(), tapsX, dstWidth);
+		}
+	});
+	ForEachRowBand(dstHeight, dstWidth, [&](int beginY, int endY)
+	{
+		for (int y = beginY; y < endY; ++y)
+		{
+			Color* const pDstRow = &dst[(ptrdiff_t)y * dstWidth];
+			ResampleRowV(pDstRow, &intermediate[(size_t)tapsY.first[y] * dstWidth], dstWidth, &tapsY.weights[(size_t)y * tapsY.maxTaps], tapsY.count[y], dstWidth);
+			UnpremultiplyRow(pDstRow, dstWidth);
+		}
+	});
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Color.h"
+#include <vector>
+
+namespace PixelKernels
+{
+	void CopyRow(Color* dst, const Color* src, int count);
+	void CopyRowWithTransparency(Color* dst, const Color* src, int count);
+	void ExpandBGRRow(Color* dst, const unsigned char* src, int count);
+	void GatherRow(Color* dst, const Color* src, const int* srcIndices, int count);
+	int NearestIndex(int dstIndex, int dstSize, int srcSize);
+	void NearestIndices(int* srcIndices, int first, int count, int dstSize, int srcSize);
+	void ExpandIndexedRow(Color* dst, const unsigned char* indices, const Color* palette, int count);
+	void ExpandRGB565Row(Color* dst, const unsigned short* src, int count);
+	void PackRGB565Row(unsigned short* dst, const Color* src, int count);
+	void BuildRemapTable(const std::vector<Color>& targets, const std::vector<Color>& replacements, std::vector<unsigned int>& sortedKeys, std::vector<Color>& values);
+	void RemapRow(Color* dst, const Color* src, int count, const unsigned int* sortedKeys, const Color* values, int nEntries);
+	void BlendRow(Color* dst, const Color* src, int count, BlendMode mode, unsigned char opacity = 255);
+	void PremultiplyRow(Color* dst, const Color* src, int count);
+	void Transpose(Color* dst, int dstPitch, const Color* src, int srcPitch, int width, int height);
+	void Resample(Color* dst, int dstWidth, int dstHeight, const Color* src, int srcWidth, int srcHeight, ResampleFilter filter);
+}
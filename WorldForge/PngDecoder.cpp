@@ -0,0 +1,620 @@
+#include "ImageDecoder.h"
+#include "BaseException.h"
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+#define PNGEXCPT EXCPT_NOTE("Critical error in reading PNG file! Please retry.")
+
+class BitReader
+{
+private:
+	const unsigned char* pData;
+	const unsigned char* pEnd;
+	unsigned long long bitBuffer = 0;
+	int bitCount = 0;
+	int overrun = 0;
+public:
+	BitReader(const unsigned char* pData, size_t size)
+		:
+		pData(pData),
+		pEnd(pData + size)
+	{}
+	void Refill()
+	{
+		while (bitCount <= 56)
+		{
+			if (pData < pEnd)
+			{
+				bitBuffer |= (unsigned long long)(*pData++) << bitCount;
+			}
+			else if (++overrun > 8)
+			{
+				throw PNGEXCPT;
+			}
+			bitCount += 8;
+		}
+	}
+	unsigned int Peek() const
+	{
+		return (unsigned int)bitBuffer;
+	}
+	void Consume(int nBits)
+	{
+		bitBuffer >>= nBits;
+		bitCount -= nBits;
+	}
+	unsigned int Bits(int nBits)
+	{
+		if (nBits == 0)
+		{
+			return 0;
+		}
+		Refill();
+		const unsigned int value = (unsigned int)(bitBuffer & ((1ULL << nBits) - 1));
+		Consume(nBits);
+		return value;
+	}
+	void AlignToByte()
+	{
+		Consume(bitCount & 7);
+	}
+	const unsigned char* BytePosition() const
+	{
+		return pData - (bitCount / 8) + overrun;
+	}
+	void SeekTo(const unsigned char* p)
+	{
+		pData = p;
+		bitBuffer = 0;
+		bitCount = 0;
+		overrun = 0;
+	}
+	const unsigned char* End() const
+	{
+		return pEnd;
+	}
+};
+
+class Huffman
+{
+private:
+	static constexpr int fastBits = 10;
+	static constexpr int maxBits = 15;
+	unsigned short fast[1 << fastBits] = {};
+	unsigned short counts[maxBits + 1] = {};
+	unsigned short symbols[288] = {};
+public:
+	void Build(const unsigned char* lengths, int nSymbols)
+	{
+		memset(fast, 0, sizeof(fast));
+		memset(counts, 0, sizeof(counts));
+		for (int s = 0; s < nSymbols; ++s)
+		{
+			++counts[lengths[s]];
+		}
+		counts[0] = 0;
+		unsigned short offsets[maxBits + 1] = {};
+		int left = 1;
+		for (int len = 1; len <= maxBits; ++len)
+		{
+			left = (left << 1) - counts[len];
+			if (left < 0)
+			{
+				throw PNGEXCPT;
+			}
+			if (len < maxBits)
+			{
+				offsets[len + 1] = offsets[len] + counts[len];
+			}
+		}
+		for (int s = 0; s < nSymbols; ++s)
+		{
+			if (lengths[s])
+			{
+				symbols[offsets[lengths[s]]++] = (unsigned short)s;
+			}
+		}
+		int code = 0;
+		int index = 0;
+		for (int len = 1; len <= fastBits; ++len)
+		{
+			for (int i = 0; i < counts[len]; ++i, ++code, ++index)
+			{
+				int reversed = 0;
+				for (int b = 0; b < len; ++b)
+				{
+					reversed |= ((code >> b) & 1) << (len - 1 - b);
+				}
+				for (int fill = reversed; fill < (1 << fastBits); fill += 1 << len)
+				{
+					fast[fill] = (unsigned short)((len << 9) | symbols[index]);
+				}
+			}
+			code <<= 1;
+		}
+	}
+	int Decode(BitReader& reader) const
+	{
+		reader.Refill();
+		const unsigned int bits = reader.Peek();
+		const unsigned short entry = fast[bits & ((1 << fastBits) - 1)];
+		if (entry)
+		{
+			reader.Consume(entry >> 9);
+			return entry & 0x1FF;
+		}
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for (int len = 1; len <= maxBits; ++len)
+		{
+			code |= (bits >> (len - 1)) & 1;
+			const int count = counts[len];
+			if (code - first < count)
+			{
+				reader.Consume(len);
+				return symbols[index + code - first];
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+		throw PNGEXCPT;
+	}
+};
+
+static void Inflate(const unsigned char* pSrc, size_t srcSize, unsigned char* pDst, size_t dstSize)
+{
+	static constexpr unsigned short lengthBase[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	static constexpr unsigned char lengthExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	static constexpr unsigned short distBase[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+	static constexpr unsigned char distExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+	static constexpr unsigned char codeLengthOrder[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+	if (srcSize < 2 || (pSrc[0] & 0x0F) != 8 || ((pSrc[0] << 8) | pSrc[1]) % 31 != 0 || (pSrc[1] & 0x20))
+	{
+		throw PNGEXCPT;
+	}
+	BitReader reader{ pSrc + 2, srcSize - 2 };
+	Huffman lengthCodes;
+	Huffman distCodes;
+	size_t out = 0;
+	bool finalBlock = false;
+	while (!finalBlock)
+	{
+		finalBlock = reader.Bits(1) != 0;
+		const unsigned int type = reader.Bits(2);
+		if (type == 0)
+		{
+			reader.AlignToByte();
+			const unsigned char* p = reader.BytePosition();
+			if (reader.End() - p < 4)
+			{
+				throw PNGEXCPT;
+			}
+			const size_t len = p[0] | (p[1] << 8);
+			const size_t nlen = p[2] | (p[3] << 8);
+			p += 4;
+			if ((len ^ 0xFFFF) != nlen || (size_t)(reader.End() - p) < len || dstSize - out < len)
+			{
+				throw PNGEXCPT;
+			}
+			memcpy(pDst + out, p, len);
+			out += len;
+			reader.SeekTo(p + len);
+			continue;
+		}
+		if (type == 1)
+		{
+			unsigned char lengths[288 + 32];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 32);
+			lengthCodes.Build(lengths, 288);
+			distCodes.Build(lengths + 288, 32);
+		}
+		else if (type == 2)
+		{
+			const int nLengthCodes = (int)reader.Bits(5) + 257;
+			const int nDistCodes = (int)reader.Bits(5) + 1;
+			const int nCodeLengthCodes = (int)reader.Bits(4) + 4;
+			unsigned char codeLengthLengths[19] = {};
+			for (int i = 0; i < nCodeLengthCodes; ++i)
+			{
+				codeLengthLengths[codeLengthOrder[i]] = (unsigned char)reader.Bits(3);
+			}
+			Huffman codeLengthCodes;
+			codeLengthCodes.Build(codeLengthLengths, 19);
+			unsigned char lengths[288 + 32] = {};
+			int n = 0;
+			while (n < nLengthCodes + nDistCodes)
+			{
+				const int symbol = codeLengthCodes.Decode(reader);
+				if (symbol < 16)
+				{
+					lengths[n++] = (unsigned char)symbol;
+					continue;
+				}
+				int repeat = 0;
+				unsigned char value = 0;
+				if (symbol == 16)
+				{
+					if (n == 0)
+					{
+						throw PNGEXCPT;
+					}
+					value = lengths[n - 1];
+					repeat = 3 + (int)reader.Bits(2);
+				}
+				else if (symbol == 17)
+				{
+					repeat = 3 + (int)reader.Bits(3);
+				}
+				else
+				{
+					repeat = 11 + (int)reader.Bits(7);
+				}
+				if (n + repeat > nLengthCodes + nDistCodes)
+				{
+					throw PNGEXCPT;
+				}
+				memset(lengths + n, value, repeat);
+				n += repeat;
+			}
+			lengthCodes.Build(lengths, nLengthCodes);
+			distCodes.Build(lengths + nLengthCodes, nDistCodes);
+		}
+		else
+		{
+			throw PNGEXCPT;
+		}
+		while (true)
+		{
+			const int symbol = lengthCodes.Decode(reader);
+			if (symbol < 256)
+			{
+				if (out >= dstSize)
+				{
+					throw PNGEXCPT;
+				}
+				pDst[out++] = (unsigned char)symbol;
+				continue;
+			}
+			if (symbol == 256)
+			{
+				break;
+			}
+			const int lengthSymbol = symbol - 257;
+			if (lengthSymbol >= 29)
+			{
+				throw PNGEXCPT;
+			}
+			const size_t length = lengthBase[lengthSymbol] + reader.Bits(lengthExtra[lengthSymbol]);
+			const int distSymbol = distCodes.Decode(reader);
+			if (distSymbol >= 30)
+			{
+				throw PNGEXCPT;
+			}
+			const size_t distance = distBase[distSymbol] + reader.Bits(distExtra[distSymbol]);
+			if (distance > out || dstSize - out < length)
+			{
+				throw PNGEXCPT;
+			}
+			const unsigned char* pCopy = pDst + out - distance;
+			unsigned char* pOut = pDst + out;
+			if (distance >= length)
+			{
+				memcpy(pOut, pCopy, length);
+			}
+			else
+			{
+				for (size_t i = 0; i < length; ++i)
+				{
+					pOut[i] = pCopy[i];
+				}
+			}
+			out += length;
+		}
+	}
+	if (out != dstSize)
+	{
+		throw PNGEXCPT;
+	}
+}
+
+static unsigned int ReadBigEndian32(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+static void Unfilter(unsigned char* pRows, int nRows, size_t rowBytes, int filterStride)
+{
+	const unsigned char* pPrev = nullptr;
+	for (int y = 0; y < nRows; ++y)
+	{
+		unsigned char* const pLine = pRows + (size_t)y * (rowBytes + 1);
+		const int filter = pLine[0];
+		unsigned char* const p = pLine + 1;
+		switch (filter)
+		{
+		case 0:
+			break;
+		case 1:
+			for (size_t i = filterStride; i < rowBytes; ++i)
+			{
+				p[i] += p[i - filterStride];
+			}
+			break;
+		case 2:
+			if (pPrev)
+			{
+				for (size_t i = 0; i < rowBytes; ++i)
+				{
+					p[i] += pPrev[i];
+				}
+			}
+			break;
+		case 3:
+			for (size_t i = 0; i < rowBytes; ++i)
+			{
+				const int left = (i >= (size_t)filterStride) ? p[i - filterStride] : 0;
+				const int up = pPrev ? pPrev[i] : 0;
+				p[i] += (unsigned char)((left + up) >> 1);
+			}
+			break;
+		case 4:
+			for (size_t i = 0; i < rowBytes; ++i)
+			{
+				const int left = (i >= (size_t)filterStride) ? p[i - filterStride] : 0;
+				const int up = pPrev ? pPrev[i] : 0;
+				const int upLeft = (pPrev && i >= (size_t)filterStride) ? pPrev[i - filterStride] : 0;
+				const int estimate = left + up - upLeft;
+				const int dLeft = abs(estimate - left);
+				const int dUp = abs(estimate - up);
+				const int dUpLeft = abs(estimate - upLeft);
+				const int predictor = (dLeft <= dUp && dLeft <= dUpLeft) ? left : (dUp <= dUpLeft ? up : upLeft);
+				p[i] += (unsigned char)predictor;
+			}
+			break;
+		default:
+			throw PNGEXCPT;
+		}
+		pPrev = p;
+	}
+}
+
+struct PngFormat
+{
+	int colorType = 0;
+	int bitDepth = 0;
+	int channels = 0;
+	const Color* pPalette = nullptr;
+	bool hasColorKey = false;
+	int keyR = 0, keyG = 0, keyB = 0;
+};
+
+static void ConvertRow(Color* pDst, int dstStep, const unsigned char* pSrc, int width, const PngFormat& format)
+{
+	const int bitDepth = format.bitDepth;
+	auto sample = [&](int x, int channel) -> int
+	{
+		if (bitDepth == 8)
+		{
+			return pSrc[x * format.channels + channel];
+		}
+		if (bitDepth == 16)
+		{
+			return pSrc[(x * format.channels + channel) * 2];
+		}
+		const int bitPos = x * bitDepth;
+		return (pSrc[bitPos >> 3] >> (8 - bitDepth - (bitPos & 7))) & ((1 << bitDepth) - 1);
+	};
+	auto sample16 = [&](int x, int channel) -> int
+	{
+		if (bitDepth == 16)
+		{
+			const unsigned char* p = &pSrc[(x * format.channels + channel) * 2];
+			return (p[0] << 8) | p[1];
+		}
+		return sample(x, channel);
+	};
+	const int greyScale = (bitDepth < 8) ? 255 / ((1 << bitDepth) - 1) : 1;
+	for (int x = 0; x < width; ++x)
+	{
+		Color& dst = pDst[(size_t)x * dstStep];
+		switch (format.colorType)
+		{
+		case 0:
+		{
+			const int v = sample(x, 0) * greyScale;
+			const bool keyed = format.hasColorKey && sample16(x, 0) == format.keyR;
+			dst = Color(v, v, v, keyed ? 0 : 255);
+			break;
+		}
+		case 2:
+		{
+			const bool keyed = format.hasColorKey && sample16(x, 0) == format.keyR && sample16(x, 1) == format.keyG && sample16(x, 2) == format.keyB;
+			dst = Color(sample(x, 0), sample(x, 1), sample(x, 2), keyed ? 0 : 255);
+			break;
+		}
+		case 3:
+			dst = format.pPalette[sample(x, 0)];
+			break;
+		case 4:
+		{
+			const int v = sample(x, 0);
+			dst = Color(v, v, v, sample(x, 1));
+			break;
+		}
+		default:
+			dst = Color(sample(x, 0), sample(x, 1), sample(x, 2), sample(x, 3));
+			break;
+		}
+	}
+}
+
+bool PngDecoder::CanDecode(const unsigned char* pData, size_t size) const
+{
+	static constexpr unsigned char signature[8] = { 0x89,'P','N','G','\r','\n',0x1A,'\n' };
+	return size >= 8 && memcmp(pData, signature, 8) == 0;
+}
+
+DecodedImage PngDecoder::Decode(const std::shared_ptr<MappedFile>& pFile) const
+{
+	const unsigned char* const pData = pFile->GetData();
+	const size_t size = pFile->GetSize();
+	size_t pos = 8;
+	DecodedImage decoded;
+	PngFormat format;
+	int interlace = 0;
+	Color palette[256];
+	for (Color& entry : palette)
+	{
+		entry = Color(0, 0, 0, 255);
+	}
+	std::vector<unsigned char> compressed;
+	bool seenHeader = false;
+	while (true)
+	{
+		if (size - pos < 12)
+		{
+			throw PNGEXCPT;
+		}
+		const unsigned int length = ReadBigEndian32(pData + pos);
+		const unsigned char* const pType = pData + pos + 4;
+		const unsigned char* const pChunk = pData + pos + 8;
+		if (length > size - pos - 12)
+		{
+			throw PNGEXCPT;
+		}
+		pos += 12 + (size_t)length;
+		if (memcmp(pType, "IHDR", 4) == 0)
+		{
+			if (length < 13)
+			{
+				throw PNGEXCPT;
+			}
+			const unsigned int fileWidth = ReadBigEndian32(pChunk);
+			const unsigned int fileHeight = ReadBigEndian32(pChunk + 4);
+			if (fileWidth > 0x7FFFFFFF || fileHeight > 0x7FFFFFFF)
+			{
+				throw EXCPT_NOTE("Image dimensions are invalid or too large! Check the image file and retry.");
+			}
+			decoded.width = (int)fileWidth;
+			decoded.height = (int)fileHeight;
+			format.bitDepth = pChunk[8];
+			format.colorType = pChunk[9];
+			interlace = pChunk[12];
+			static constexpr int channelsPerType[7] = { 1,0,3,1,2,0,4 };
+			format.channels = (format.colorType <= 6) ? channelsPerType[format.colorType] : 0;
+			const int bd = format.bitDepth;
+			const bool validDepth = (bd == 8 || bd == 16 || ((format.colorType == 0 || format.colorType == 3) && (bd == 1 || bd == 2 || bd == 4))) && !(format.colorType == 3 && bd == 16);
+			if (format.channels == 0 || !validDepth || pChunk[10] != 0 || pChunk[11] != 0 || interlace > 1)
+			{
+				throw EXCPT_NOTE("Unsupported PNG color format! Re-export image and retry.");
+			}
+			seenHeader = true;
+		}
+		else if (memcmp(pType, "PLTE", 4) == 0)
+		{
+			for (unsigned int i = 0; i < length / 3 && i < 256; ++i)
+			{
+				palette[i] = Color(pChunk[i * 3], pChunk[i * 3 + 1], pChunk[i * 3 + 2], (unsigned char)255);
+			}
+		}
+		else if (memcmp(pType, "tRNS", 4) == 0)
+		{
+			if (format.colorType == 3)
+			{
+				for (unsigned int i = 0; i < length && i < 256; ++i)
+				{
+					palette[i].SetA(pChunk[i]);
+				}
+			}
+			else if (format.colorType == 0 && length >= 2)
+			{
+				format.hasColorKey = true;
+				format.keyR = (pChunk[0] << 8) | pChunk[1];
+			}
+			else if (format.colorType == 2 && length >= 6)
+			{
+				format.hasColorKey = true;
+				format.keyR = (pChunk[0] << 8) | pChunk[1];
+				format.keyG = (pChunk[2] << 8) | pChunk[3];
+				format.keyB = (pChunk[4] << 8) | pChunk[5];
+			}
+		}
+		else if (memcmp(pType, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), pChunk, pChunk + length);
+		}
+		else if (memcmp(pType, "IEND", 4) == 0)
+		{
+			break;
+		}
+		else if (!(pType[0] & 0x20))
+		{
+			throw EXCPT_NOTE("Unsupported critical PNG chunk! Re-export image and retry.");
+		}
+	}
+	if (!seenHeader)
+	{
+		throw PNGEXCPT;
+	}
+	if (format.bitDepth < 8 && format.colorType == 0 && format.hasColorKey)
+	{
+		format.keyR &= (1 << format.bitDepth) - 1;
+	}
+	else if (format.bitDepth == 8 && format.hasColorKey)
+	{
+		format.keyR &= 0xFF;
+		format.keyG &= 0xFF;
+		format.keyB &= 0xFF;
+	}
+	format.pPalette = palette;
+	decoded.pPixels = AllocatePixels(decoded.width, decoded.height);
+	const int bitsPerPixel = format.channels * format.bitDepth;
+	const int filterStride = (bitsPerPixel + 7) / 8;
+	struct Pass
+	{
+		int x0, y0, dx, dy;
+	};
+	static constexpr Pass passes[8] = { { 0,0,1,1 },{ 0,0,8,8 },{ 4,0,8,8 },{ 0,4,4,8 },{ 2,0,4,4 },{ 0,2,2,4 },{ 1,0,2,2 },{ 0,1,1,2 } };
+	const int firstPass = interlace ? 1 : 0;
+	const int lastPass = interlace ? 7 : 0;
+	size_t totalBytes = 0;
+	for (int p = firstPass; p <= lastPass; ++p)
+	{
+		const int passWidth = (decoded.width - passes[p].x0 + passes[p].dx - 1) / passes[p].dx;
+		const int passHeight = (decoded.height - passes[p].y0 + passes[p].dy - 1) / passes[p].dy;
+		if (passWidth > 0 && passHeight > 0)
+		{
+			totalBytes += ((size_t)passWidth * bitsPerPixel + 7) / 8 * passHeight + passHeight;
+		}
+	}
+	std::vector<unsigned char> raw(totalBytes);
+	Inflate(compressed.data(), compressed.size(), raw.data(), raw.size());
+	unsigned char* pPassData = raw.data();
+	for (int p = firstPass; p <= lastPass; ++p)
+	{
+		const Pass& pass = passes[p];
+		const int passWidth = (decoded.width - pass.x0 + pass.dx - 1) / pass.dx;
+		const int passHeight = (decoded.height - pass.y0 + pass.dy - 1) / pass.dy;
+		if (passWidth <= 0 || passHeight <= 0)
+		{
+			continue;
+		}
+		const size_t rowBytes = ((size_t)passWidth * bitsPerPixel + 7) / 8;
+		Unfilter(pPassData, passHeight, rowBytes, filterStride);
+		for (int y = 0; y < passHeight; ++y)
+		{
+			Color* const pDst = &decoded.pPixels[(size_t)(pass.y0 + y * pass.dy) * decoded.width + pass.x0];
+			ConvertRow(pDst, pass.dx, pPassData + (size_t)y * (rowBytes + 1) + 1, passWidth, format);
+		}
+		pPassData += (rowBytes + 1) * passHeight;
+	}
+	return decoded;
+}
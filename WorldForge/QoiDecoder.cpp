@@ -0,0 +1,123 @@
+#include "ImageDecoder.h"
+#include "BaseException.h"
+#include <string.h>
+
+static unsigned int ReadBigEndian32(const unsigned char* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+bool QoiDecoder::CanDecode(const unsigned char* pData, size_t size) const
+{
+	return size >= 4 && memcmp(pData, "qoif", 4) == 0;
+}
+
+DecodedImage QoiDecoder::Decode(const std::shared_ptr<MappedFile>& pFile) const
+{
+	constexpr size_t headerSize = 14;
+	constexpr size_t endMarkerSize = 8;
+	const unsigned char* const pData = pFile->GetData();
+	const size_t size = pFile->GetSize();
+	if (size < headerSize + endMarkerSize)
+	{
+		throw EXCPT_NOTE("Critical error in reading QOI file! Please retry.");
+	}
+	const unsigned int fileWidth = ReadBigEndian32(pData + 4);
+	const unsigned int fileHeight = ReadBigEndian32(pData + 8);
+	if (fileWidth > 0x7FFFFFFF || fileHeight > 0x7FFFFFFF)
+	{
+		throw EXCPT_NOTE("Image dimensions are invalid or too large! Check the image file and retry.");
+	}
+	DecodedImage decoded;
+	decoded.width = (int)fileWidth;
+	decoded.height = (int)fileHeight;
+	decoded.pPixels = AllocatePixels(decoded.width, decoded.height);
+	Color* const pPixels = decoded.pPixels.get();
+	const int nPixels = decoded.width * decoded.height;
+	Color index[64];
+	for (Color& entry : index)
+	{
+		entry = Color(0, 0, 0, 0);
+	}
+	int r = 0, g = 0, b = 0, a = 255;
+	size_t pos = headerSize;
+	const size_t chunksEnd = size - endMarkerSize;
+	int run = 0;
+	for (int i = 0; i < nPixels; ++i)
+	{
+		if (run > 0)
+		{
+			--run;
+		}
+		else
+		{
+			if (pos >= chunksEnd)
+			{
+				throw EXCPT_NOTE("Critical error in reading QOI file! Please retry.");
+			}
+			const int tag = pData[pos++];
+			if (tag == 0xFE)
+			{
+				if (pos + 3 > chunksEnd)
+				{
+					throw EXCPT_NOTE("Critical error in reading QOI file! Please retry.");
+				}
+				r = pData[pos];
+				g = pData[pos + 1];
+				b = pData[pos + 2];
+				pos += 3;
+			}
+			else if (tag == 0xFF)
+			{
+				if (pos + 4 > chunksEnd)
+				{
+					throw EXCPT_NOTE("Critical error in reading QOI file! Please retry.");
+				}
+				r = pData[pos];
+				g = pData[pos + 1];
+				b = pData[pos + 2];
+				a = pData[pos + 3];
+				pos += 4;
+			}
+			else
+			{
+				switch (tag >> 6)
+				{
+				case 0:
+				{
+					const Color& entry = index[tag];
+					r = entry.GetR();
+					g = entry.GetG();
+					b = entry.GetB();
+					a = entry.GetA();
+					break;
+				}
+				case 1:
+					r = (r + ((tag >> 4) & 3) - 2) & 0xFF;
+					g = (g + ((tag >> 2) & 3) - 2) & 0xFF;
+					b = (b + (tag & 3) - 2) & 0xFF;
+					break;
+				case 2:
+				{
+					if (pos >= chunksEnd)
+					{
+						throw EXCPT_NOTE("Critical error in reading QOI file! Please retry.");
+					}
+					const int next = pData[pos++];
+					const int dg = (tag & 0x3F) - 32;
+					r = (r + dg - 8 + ((next >> 4) & 0x0F)) & 0xFF;
+					g = (g + dg) & 0xFF;
+					b = (b + dg - 8 + (next & 0x0F)) & 0xFF;
+					break;
+				}
+				default:
+					run = tag & 0x3F;
+					break;
+				}
+			}
+			index[(r * 3 + g * 5 + b * 7 + a * 11) & 63] = Color(r, g, b, a);
+		}
+		pPixels[i] = Color(r, g, b, a);
+	}
+	return decoded;
+}
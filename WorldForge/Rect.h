@@ -205,6 +205,7 @@ public:
 		Rect<int> drawRect = Rect<int>(*this);
 		assert(drawRect.IsTouching(gfxRect)); 
 		drawRect.ClipTo(gfxRect);
+		gfx.MarkDirty(drawRect, layer);
 		const int mapWidth = (int)gfx.GetWidth(layer);
 		std::vector<Color>& pxlMap = gfx.GetPixelMap(layer);
 		const auto yIterBegin = pxlMap.begin() + drawRect.pos.y * mapWidth;
@@ -1,5 +1,6 @@
 #include "SVG.h"
 #include "Math.h"
+#include <string.h>
 
 SVG::SVG(std::vector<std::pair<vec2, vec2>> line_buffer)
 	:
@@ -22,6 +23,62 @@ const std::vector<std::pair<vec2, vec2>> SVG::GetLineBuffer() const
 	return lineBuffer;
 }
 
+mat3 SVG::GetPixelMapTransformMatrix(const Graphics& gfx, const mat3& view, int layer) const
+{
+	return GetTransformationMatrix() * view * gfx.GetWorldToPixelMapTransformMatrix(layer);
+}
+
+const std::vector<CoverageRasterizer::Edge>& SVG::GetFillEdges(const mat3& transform) const
+{
+	if (!isFillCached || memcmp(&fillTransform, &transform, sizeof(mat3)) != 0)
+	{
+		fillEdges.clear();
+		for (const std::pair<vec2, vec2>& line : lineBuffer)
+		{
+			fillEdges.push_back({ vec2(vec3(line.first) * transform), vec2(vec3(line.second) * transform) });
+		}
+		fillTransform = transform;
+		isFillCached = true;
+	}
+	return fillEdges;
+}
+
+const std::vector<CoverageRasterizer::Edge>& SVG::GetStrokeEdges(const mat3& transform, float thickness) const
+{
+	if (!isStrokeCached || strokeThickness != thickness || memcmp(&strokeTransform, &transform, sizeof(mat3)) != 0)
+	{
+		strokeEdges.clear();
+		for (const std::pair<vec2, vec2>& line : lineBuffer)
+		{
+			CoverageRasterizer::AppendStrokeEdges(strokeEdges, vec2(vec3(line.first) * transform), vec2(vec3(line.second) * transform), thickness);
+		}
+		strokeTransform = transform;
+		strokeThickness = thickness;
+		isStrokeCached = true;
+	}
+	return strokeEdges;
+}
+
+void SVG::Draw(Graphics& gfx, const Color& color, int layer) const
+{
+	Draw(gfx, mat3::Identity(), color, layer);
+}
+
+void SVG::Draw(Graphics& gfx, const mat3& view, const Color& color, int layer) const
+{
+	CoverageRasterizer::Fill(gfx, GetFillEdges(GetPixelMapTransformMatrix(gfx, view, layer)), color, layer);
+}
+
+void SVG::DrawOutline(Graphics& gfx, const Color& color, float thickness, int layer) const
+{
+	DrawOutline(gfx, mat3::Identity(), color, thickness, layer);
+}
+
+void SVG::DrawOutline(Graphics& gfx, const mat3& view, const Color& color, float thickness, int layer) const
+{
+	CoverageRasterizer::Fill(gfx, GetStrokeEdges(GetPixelMapTransformMatrix(gfx, view, layer), thickness), color, layer);
+}
+
 SVG SVG::GenerateLine(vec2 p0, vec2 p1)
 {
 	std::vector<std::pair<vec2, vec2>> lineBuffer;
@@ -1,17 +1,34 @@
 #pragma once
 #include "Graphics.h"
 #include "Transformable.h"
+#include "CoverageRasterizer.h"
 #include <vector>
 
 class SVG : public Transformable
 {
 protected:
 	std::vector<std::pair<vec2, vec2>> lineBuffer;
+private:
+	mutable std::vector<CoverageRasterizer::Edge> fillEdges;
+	mutable std::vector<CoverageRasterizer::Edge> strokeEdges;
+	mutable mat3 fillTransform;
+	mutable mat3 strokeTransform;
+	mutable float strokeThickness = 0.0f;
+	mutable bool isFillCached = false;
+	mutable bool isStrokeCached = false;
+private:
+	mat3 GetPixelMapTransformMatrix(const Graphics& gfx, const mat3& view, int layer) const;
+	const std::vector<CoverageRasterizer::Edge>& GetFillEdges(const mat3& transform) const;
+	const std::vector<CoverageRasterizer::Edge>& GetStrokeEdges(const mat3& transform, float thickness) const;
 public:
 	SVG() = delete;
 	SVG(std::vector<std::pair<vec2, vec2>> line_buffer);
 	SVG(std::vector<std::pair<vec2, vec2>> line_buffer, vec2 pos, float rotation, vec2 scale);
 	const std::vector<std::pair<vec2, vec2>> GetLineBuffer() const;
+	void Draw(Graphics& gfx, const Color& color, int layer = 0) const;
+	void Draw(Graphics& gfx, const mat3& view, const Color& color, int layer = 0) const;
+	void DrawOutline(Graphics& gfx, const Color& color, float thickness = 1.0f, int layer = 0) const;
+	void DrawOutline(Graphics& gfx, const mat3& view, const Color& color, float thickness = 1.0f, int layer = 0) const;
 public:
 	static SVG GenerateLine(vec2 p0, vec2 p1);
 	static SVG GeneratePolygon(int nSides, vec2 pos = { 0.0f,0.0f }, float rot = 0.0f, vec2 scale = { 1.0f,1.0f });
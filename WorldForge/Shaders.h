@@ -1,9 +1,15 @@
 #pragma once
 #include "Vector.h"
-#include <wrl.h>
 #include <assert.h>
+#ifdef _WIN32
+#include <wrl.h>
 #include <D3Dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib")
+#else
+#include <fstream>
+#include <iterator>
+#include <string>
+#endif
 #include <vector>
 
 /*
@@ -14,6 +20,7 @@
 
 class Shader
 {
+#ifdef _WIN32
 private:
 	Microsoft::WRL::ComPtr<ID3DBlob> pShader = nullptr;
 public:
@@ -34,6 +41,34 @@ public:
 	{
 		return (int)pShader->GetBufferSize();
 	}
+#else
+private:
+	std::vector<char> byteCode;
+public:
+	Shader() = default;
+	Shader(const wchar_t* filename)
+	{
+		LoadShaderFile(filename);
+	}
+	void LoadShaderFile(const wchar_t* filename)
+	{
+		std::string narrowName;
+		for (const wchar_t* c = filename; *c; ++c)
+		{
+			narrowName.push_back((char)*c);
+		}
+		std::ifstream file(narrowName, std::ios::binary);
+		byteCode.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	const void* GetByteCode() const
+	{
+		return byteCode.data();
+	}
+	int GetByteCodeSize() const
+	{
+		return (int)byteCode.size();
+	}
+#endif
 };
 
 /*
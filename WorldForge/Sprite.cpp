@@ -327,3 +327,43 @@ bool Sprite::DrawWithTransparency(Graphics& gfx, int layer) const
 	}
 }
 
+bool Sprite::Queue(Graphics& gfx, int depth, int layer) const
+{
+	if (imageRect.IsTouching(gfx.GetRect_FLOAT(layer)))
+	{
+		if (scale != vec2(1.0f, 1.0f))
+		{
+			gfx.QueueImage(animations[currentAnimation].GetCurrentFrame(), iRect({ (int)position.x,(int)position.y }, (int)imageRect.GetWidth(), (int)imageRect.GetHeight()), depth, layer);
+		}
+		else
+		{
+			gfx.QueueImage(animations[currentAnimation].GetCurrentFrame(), (int)position.x, (int)position.y, depth, layer);
+		}
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+bool Sprite::QueueWithTransparency(Graphics& gfx, int depth, int layer) const
+{
+	if (imageRect.IsTouching(gfx.GetRect_FLOAT(layer)))
+	{
+		if (scale != vec2(1.0f, 1.0f))
+		{
+			gfx.QueueImageWithTransparency(animations[currentAnimation].GetCurrentFrame(), iRect({ (int)position.x,(int)position.y }, (int)imageRect.GetWidth(), (int)imageRect.GetHeight()), depth, layer);
+		}
+		else
+		{
+			gfx.QueueImageWithTransparency(animations[currentAnimation].GetCurrentFrame(), (int)position.x, (int)position.y, depth, layer);
+		}
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
@@ -40,5 +40,7 @@ public:
 	virtual bool UpdateAndCheck(float time_ellapsed);
 	virtual bool Draw(Graphics& gfx, int layer = 0) const;
 	virtual bool DrawWithTransparency(Graphics& gfx, int layer = 0) const;
+	virtual bool Queue(Graphics& gfx, int depth = 0, int layer = 0) const;
+	virtual bool QueueWithTransparency(Graphics& gfx, int depth = 0, int layer = 0) const;
 };
 
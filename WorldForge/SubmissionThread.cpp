@@ -0,0 +1,103 @@
+#include "SubmissionThread.h"
+
+void SubmissionThread::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			wakeCondition.wait(lock, [&]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+			{
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			if (!pError)
+			{
+				pError = std::current_exception();
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			++nCompleted;
+		}
+		doneCondition.notify_all();
+	}
+}
+
+void SubmissionThread::RethrowError()
+{
+	std::exception_ptr pPending = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		std::swap(pPending, pError);
+	}
+	if (pPending)
+	{
+		std::rethrow_exception(pPending);
+	}
+}
+
+SubmissionThread::SubmissionThread()
+	:
+	worker(&SubmissionThread::WorkerLoop, this)
+{}
+
+SubmissionThread::~SubmissionThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_one();
+	worker.join();
+}
+
+unsigned long long SubmissionThread::Submit(std::function<void()> job)
+{
+	RethrowError();
+	unsigned long long fence = 0;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		jobs.push_back(std::move(job));
+		fence = ++nSubmitted;
+	}
+	wakeCondition.notify_one();
+	return fence;
+}
+
+unsigned long long SubmissionThread::GetLastFence()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return nSubmitted;
+}
+
+bool SubmissionThread::isComplete(unsigned long long fence)
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return nCompleted >= fence;
+}
+
+void SubmissionThread::Wait(unsigned long long fence)
+{
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		doneCondition.wait(lock, [&]() { return nCompleted >= fence; });
+	}
+	RethrowError();
+}
+
+void SubmissionThread::WaitIdle()
+{
+	Wait(GetLastFence());
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <exception>
+
+class SubmissionThread
+{
+private:
+	std::mutex queueMutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	std::deque<std::function<void()>> jobs;
+	unsigned long long nSubmitted = 0;
+	unsigned long long nCompleted = 0;
+	std::exception_ptr pError = nullptr;
+	bool stopping = false;
+	std::thread worker;
+private:
+	void WorkerLoop();
+	void RethrowError();
+public:
+	SubmissionThread();
+	SubmissionThread(const SubmissionThread& submitter) = delete;
+	SubmissionThread& operator =(const SubmissionThread& submitter) = delete;
+	~SubmissionThread();
+	unsigned long long Submit(std::function<void()> job);
+	unsigned long long GetLastFence();
+	bool isComplete(unsigned long long fence);
+	void Wait(unsigned long long fence);
+	void WaitIdle();
+};
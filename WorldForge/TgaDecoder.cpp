@@ -0,0 +1,145 @@
+#include "ImageDecoder.h"
+#include "BaseException.h"
+#include <string.h>
+#include <algorithm>
+
+static constexpr size_t tgaHeaderSize = 18;
+
+static bool IsSupportedTgaHeader(const unsigned char* pData, size_t size)
+{
+	if (size < tgaHeaderSize)
+	{
+		return false;
+	}
+	const int colorMapType = pData[1];
+	const int imageType = pData[2];
+	const int bitsPerPixel = pData[16];
+	const bool trueColor = (imageType == 2 || imageType == 10) && (bitsPerPixel == 24 || bitsPerPixel == 32);
+	const bool greyScale = (imageType == 3 || imageType == 11) && bitsPerPixel == 8;
+	return colorMapType == 0 && (trueColor || greyScale);
+}
+
+bool TgaDecoder::CanDecode(const unsigned char* pData, size_t size) const
+{
+	return IsSupportedTgaHeader(pData, size);
+}
+
+DecodedImage TgaDecoder::Decode(const std::shared_ptr<MappedFile>& pFile) const
+{
+	const unsigned char* const pData = pFile->GetData();
+	const size_t size = pFile->GetSize();
+	if (!IsSupportedTgaHeader(pData, size))
+	{
+		throw EXCPT_NOTE("Only uncompressed or RLE true-color and greyscale TGA files supported! Re-export image and retry.");
+	}
+	const int idLength = pData[0];
+	const int imageType = pData[2];
+	const int bytesPerPixel = pData[16] / 8;
+	const bool topDown = (pData[17] & 0x20) != 0;
+	const bool rightToLeft = (pData[17] & 0x10) != 0;
+	const bool hasAlpha = bytesPerPixel == 4 && (pData[17] & 0x0F) != 0;
+	DecodedImage decoded;
+	decoded.width = pData[12] | (pData[13] << 8);
+	decoded.height = pData[14] | (pData[15] << 8);
+	decoded.pPixels = AllocatePixels(decoded.width, decoded.height);
+	Color* const pPixels = decoded.pPixels.get();
+	const int width = decoded.width;
+	const int height = decoded.height;
+	auto readPixel = [bytesPerPixel, hasAlpha](const unsigned char* p)
+	{
+		if (bytesPerPixel == 1)
+		{
+			return Color(p[0], p[0], p[0], (unsigned char)255);
+		}
+		return Color(p[2], p[1], p[0], hasAlpha ? p[3] : (unsigned char)255);
+	};
+	auto rowStart = [&](int fileRow)
+	{
+		const int y = topDown ? fileRow : height - fileRow - 1;
+		return &pPixels[(size_t)y * width];
+	};
+	size_t pos = tgaHeaderSize + idLength;
+	if (imageType == 2 || imageType == 3)
+	{
+		if (pos > size || (long long)(size - pos) < (long long)width * height * bytesPerPixel)
+		{
+			throw EXCPT_NOTE("Critical error in reading TGA file! Please retry.");
+		}
+		for (int row = 0; row < height; ++row)
+		{
+			Color* const pRow = rowStart(row);
+			const unsigned char* const pSrc = pData + pos + (size_t)row * width * bytesPerPixel;
+			if (bytesPerPixel == 4 && hasAlpha)
+			{
+				memcpy(pRow, pSrc, width * sizeof(Color));
+			}
+			else
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					pRow[x] = readPixel(pSrc + x * bytesPerPixel);
+				}
+			}
+		}
+	}
+	else
+	{
+		int row = 0;
+		int x = 0;
+		Color* pRow = rowStart(0);
+		auto emit = [&](const Color& color)
+		{
+			pRow[x] = color;
+			if (++x == width)
+			{
+				x = 0;
+				if (++row < height)
+				{
+					pRow = rowStart(row);
+				}
+			}
+		};
+		while (row < height)
+		{
+			if (pos >= size)
+			{
+				throw EXCPT_NOTE("Critical error in reading TGA file! Please retry.");
+			}
+			const int packet = pData[pos++];
+			const int count = (packet & 0x7F) + 1;
+			if (packet & 0x80)
+			{
+				if (pos + bytesPerPixel > size)
+				{
+					throw EXCPT_NOTE("Critical error in reading TGA file! Please retry.");
+				}
+				const Color color = readPixel(pData + pos);
+				pos += bytesPerPixel;
+				for (int i = 0; i < count && row < height; ++i)
+				{
+					emit(color);
+				}
+			}
+			else
+			{
+				if (pos + (size_t)count * bytesPerPixel > size)
+				{
+					throw EXCPT_NOTE("Critical error in reading TGA file! Please retry.");
+				}
+				for (int i = 0; i < count && row < height; ++i)
+				{
+					emit(readPixel(pData + pos));
+					pos += bytesPerPixel;
+				}
+			}
+		}
+	}
+	if (rightToLeft)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			std::reverse(&pPixels[(size_t)y * width], &pPixels[(size_t)y * width] + width);
+		}
+	}
+	return decoded;
+}
@@ -237,4 +237,44 @@ bool Tile::DrawWithTransparency(Graphics& gfx, int layer) const
 	{
 		return false;
 	}
+}
+
+bool Tile::Queue(Graphics& gfx, int depth, int layer) const
+{
+	if (imageRect.IsTouching(gfx.GetRect_FLOAT(layer)))
+	{
+		if (scale != vec2(1.0f, 1.0f))
+		{
+			gfx.QueueImage(image.GetCurrentFrame(), iRect({ (int)position.x,(int)position.y }, (int)GetWidth(), (int)GetHeight()), depth, layer);
+		}
+		else
+		{
+			gfx.QueueImage(image.GetCurrentFrame(), (int)position.x, (int)position.y, depth, layer);
+		}
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+bool Tile::QueueWithTransparency(Graphics& gfx, int depth, int layer) const
+{
+	if (imageRect.IsTouching(gfx.GetRect_FLOAT(layer)))
+	{
+		if (scale != vec2(1.0f, 1.0f))
+		{
+			gfx.QueueImageWithTransparency(image.GetCurrentFrame(), iRect({ (int)position.x,(int)position.y }, (int)GetWidth(), (int)GetHeight()), depth, layer);
+		}
+		else
+		{
+			gfx.QueueImageWithTransparency(image.GetCurrentFrame(), (int)position.x, (int)position.y, depth, layer);
+		}
+		return true;
+	}
+	else
+	{
+		return false;
+	}
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "TileCodec.h"
+#include "BaseException.h"
+#include <algorithm>
+
+#define TILEEXCPT EXCPT_NOTE("Tile data is corrupt or truncated! Please check the file and retry.")
+
+static void WriteVarint(std::vector<unsigned char>& out, unsigned int value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+static unsigned int ReadVarint(const unsigned char*& p, const unsigned char* pEnd)
+{
+	unsigned int value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (p == pEnd)
+		{
+			throw TILEEXCPT;
+		}
+		const unsigned char byte = *p++;
+		value |= (unsigned int)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return value;
+		}
+	}
+	throw TILEEXCPT;
+}
+
+void TileCodec::EncodeRuns(const int* pIds, int count, std::vector<unsigned char>& out)
+{
+	for (int i = 0; i < count;)
+	{
+		int run = 1;
+		while (i + run < count && pIds[i + run] == pIds[i])
+		{
+			++run;
+		}
+		WriteVarint(out, (unsigned int)run);
+		WriteVarint(out, (unsigned int)pIds[i]);
+		i += run;
+	}
+}
+
+template<typename T>
+void TileCodec::DecodeRuns(const unsigned char* pSrc, size_t size, T* pIds, int count, unsigned int max_id)
+{
+	const unsigned char* p = pSrc;
+	const unsigned char* const pEnd = pSrc + size;
+	int i = 0;
+	while (i < count)
+	{
+		const unsigned int run = ReadVarint(p, pEnd);
+		const unsigned int id = ReadVarint(p, pEnd);
+		if (run == 0 || run > (unsigned int)(count - i) || id > max_id)
+		{
+			throw TILEEXCPT;
+		}
+		std::fill_n(&pIds[i], run, (T)id);
+		i += (int)run;
+	}
+	if (p != pEnd)
+	{
+		throw TILEEXCPT;
+	}
+}
+
+template void TileCodec::DecodeRuns<unsigned char>(const unsigned char*, size_t, unsigned char*, int, unsigned int);
+template void TileCodec::DecodeRuns<unsigned short>(const unsigned char*, size_t, unsigned short*, int, unsigned int);
+template void TileCodec::DecodeRuns<unsigned int>(const unsigned char*, size_t, unsigned int*, int, unsigned int);
+template void TileCodec::DecodeRuns<int>(const unsigned char*, size_t, int*, int, unsigned int);
@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+// tile ids are stored as (run length, id) pairs of LEB128 varints
+namespace TileCodec
+{
+	void EncodeRuns(const int* pIds, int count, std::vector<unsigned char>& out);
+	// ids above max_id are rejected as corrupt, so narrow destinations never truncate
+	template<typename T>
+	void DecodeRuns(const unsigned char* pSrc, size_t size, T* pIds, int count, unsigned int max_id);
+}
@@ -37,6 +37,8 @@ void UserInterface::Draw()
 		{
 			pObject->Draw(gfx, layer, gfcText);
 		}
+		// text is written through the paper pointer GraphicText took at construction, which the layer cannot see
+		gfx.MarkDirty(gfx.GetRect(layer), layer);
 		drawFlag = false;
 	}
 }
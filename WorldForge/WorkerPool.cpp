@@ -0,0 +1,125 @@
+#include "WorkerPool.h"
+#include <algorithm>
+#include <assert.h>
+
+static thread_local bool isPoolWorker = false;
+
+void WorkerPool::WorkerLoop()
+{
+	isPoolWorker = true;
+	unsigned long long seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(stateMutex);
+			wakeCondition.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+		RunTasks();
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			++nFinished;
+		}
+		doneCondition.notify_one();
+	}
+}
+
+void WorkerPool::RunTasks()
+{
+	for (int i = nextTask.fetch_add(1); i < nTasks; i = nextTask.fetch_add(1))
+	{
+		(*pTask)(i);
+	}
+}
+
+void WorkerPool::StartWorkers(int nThreads)
+{
+	if (nThreads <= 0)
+	{
+		nThreads = (int)std::max(1u, std::thread::hardware_concurrency());
+	}
+	stopping = false;
+	workers.reserve(nThreads - 1);
+	for (int i = 1; i < nThreads; ++i)
+	{
+		workers.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+void WorkerPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		stopping = true;
+	}
+	wakeCondition.notify_all();
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+WorkerPool::WorkerPool(int nThreads)
+{
+	StartWorkers(nThreads);
+}
+
+WorkerPool::~WorkerPool()
+{
+	StopWorkers();
+}
+
+void WorkerPool::SetThreadCount(int nThreads)
+{
+	std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+	StopWorkers();
+	StartWorkers(nThreads);
+}
+
+int WorkerPool::GetThreadCount() const
+{
+	return (int)workers.size() + 1;
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	if (count == 1 || workers.empty() || isPoolWorker)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			task(i);
+		}
+		return;
+	}
+	std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		pTask = &task;
+		nTasks = count;
+		nextTask = 0;
+		nFinished = 0;
+		++generation;
+	}
+	wakeCondition.notify_all();
+	isPoolWorker = true;
+	RunTasks();
+	isPoolWorker = false;
+	std::unique_lock<std::mutex> lock(stateMutex);
+	doneCondition.wait(lock, [&]() { return nFinished == (int)workers.size(); });
+	pTask = nullptr;
+}
+
+WorkerPool& WorkerPool::Shared()
+{
+	static WorkerPool pool;
+	return pool;
+}
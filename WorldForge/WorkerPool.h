@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+class WorkerPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::mutex dispatchMutex;
+	std::mutex stateMutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(int)>* pTask = nullptr;
+	std::atomic<int> nextTask = 0;
+	int nTasks = 0;
+	int nFinished = 0;
+	unsigned long long generation = 0;
+	bool stopping = false;
+private:
+	void WorkerLoop();
+	void RunTasks();
+	void StartWorkers(int nThreads);
+	void StopWorkers();
+public:
+	WorkerPool(int nThreads = 0);
+	WorkerPool(const WorkerPool& pool) = delete;
+	WorkerPool& operator =(const WorkerPool& pool) = delete;
+	~WorkerPool();
+	void SetThreadCount(int nThreads);
+	int GetThreadCount() const;
+	void ParallelFor(int count, const std::function<void(int)>& task);
+	static WorkerPool& Shared();
+};